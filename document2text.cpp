@@ -1,39 +1,29 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
+#include "document2text.h"
 #include "msoffice/ms_doc.h"
 #include "msoffice/ms_ppt.h"
 #include "msoffice/ms_xls/ms_xls.h"
 #include "msoffice/officex.h"
 #include "simplepdf/simplepdf.h"
+#include "utils/ordered_budget.h"
+#include "utils/thread_pool.h"
 #include "utils/utils.h"
 
-enum document_type_t {
-  kDocTypeUnknown = 0,
-  kDocTypePDF = 1,
-  kDocTypeDOC = 2,
-  kDocTypePPT = 3,
-  kDocTypeXLS = 4,
-  kDocTypeDOCX = 5,
-  kDocTypePPTX = 6,
-  kDocTypeXLSX = 7,
-};
-
-enum doc2txt_result_t {
-  kDoc2txtOK = 0,
-  kDoc2txtFail = -1,
-  kDoc2txtConvertErr = -2,
-};
-
-struct fetch_opts_t {
-  size_t max_fetch_text_len;
-  int max_fetch_pdf_page_cnt;
-  int max_xls_sst_cnt;
-  document_type_t type;
-};
+namespace doc2txt {
 
 static bool is_document_pdf(const char *p, size_t plen) {
   if (plen > 5 && p != nullptr && strncmp(p, "%PDF-", 5) == 0) {
@@ -57,36 +47,44 @@ static inline bool is_zip(const char *p, size_t plen) {
 
 static doc2txt_result_t pdf2text(const char *data, size_t len,
                                  size_t max_fetch_text_len,
-                                 int max_fetch_pdf_page_cnt,
+                                 int max_fetch_pdf_page_cnt, int workers,
                                  std::string *text) {
-  simplepdf::SimplePDF pdf(data, len);
-  int page_cnt = pdf.PagesCnt();
-  for (int i = 1;
-       i <= page_cnt && i <= max_fetch_pdf_page_cnt && max_fetch_text_len > 0;
-       ++i) {
+  workers = std::max(workers, 1);
+  std::vector<std::unique_ptr<simplepdf::SimplePDF>> pdfs(workers);
+  pdfs[0].reset(new simplepdf::SimplePDF(data, len));
+  int page_cnt = std::min(pdfs[0]->PagesCnt(), max_fetch_pdf_page_cnt);
+  if (page_cnt <= 0) {
+    return kDoc2txtOK;
+  }
+
+  // Every worker parses its own PDFDoc over the shared buffer; worker 0 runs
+  // on this thread and reuses the one opened above.
+  utils::OrderedBudget budget(max_fetch_text_len, text);
+  utils::ParallelFor(page_cnt, workers, [&](int worker, size_t idx) {
+    size_t max_len = budget.Remaining(idx);
+    if (max_len == 0) {
+      budget.Skip(idx);
+      return;
+    }
+    if (pdfs[worker] == nullptr) {
+      pdfs[worker].reset(new simplepdf::SimplePDF(data, len));
+    }
+
     try {
-      auto t = pdf.PageText(i);
+      auto t = pdfs[worker]->PageText(idx + 1, max_len);
       if (t == nullptr || t->c_str() == nullptr) {
-        continue;
-      }
-
-      size_t len = utils::count_utf8_word_cnt(t->c_str(), t->getLength());
-      if (max_fetch_text_len >= len) {
-        text->append(t->c_str(), t->getLength());
-        max_fetch_text_len -= len;
+        budget.Skip(idx);
       } else {
-        size_t offset =
-            utils::fix_utf8_word_cnt(t->c_str(), max_fetch_text_len);
-        text->append(t->c_str(), offset);
-        max_fetch_text_len = 0;
+        budget.Commit(idx, t->c_str(), t->getLength());
       }
     } catch (std::exception &ex) {
+      budget.Skip(idx);
     }
-  }
+  });
   return kDoc2txtOK;
 }
 
-doc2txt_result_t document2text(const char *data, size_t len,
+static doc2txt_result_t document2text(const char *data, size_t len,
                                const fetch_opts_t &opts, std::string *text,
                                document_type_t *type) {
   *type = kDocTypeUnknown;
@@ -95,7 +93,7 @@ doc2txt_result_t document2text(const char *data, size_t len,
       (opts.type == kDocTypeUnknown && is_document_pdf(data, len))) {
     *type = kDocTypePDF;
     return pdf2text(data, len, opts.max_fetch_text_len,
-                    opts.max_fetch_pdf_page_cnt, text);
+                    opts.max_fetch_pdf_page_cnt, opts.pdf_page_workers, text);
   }
 
   msoffice::fetch_text_options_t fopts;
@@ -104,7 +102,14 @@ doc2txt_result_t document2text(const char *data, size_t len,
   fopts.xls_delimiter = ",";
   fopts.xls_skip_blank_cell = true;
   fopts.xls_max_sst_cnt = opts.max_xls_sst_cnt;
-  fopts.xml_max_file_len = 1024 * 1024;
+  if (opts.xml_window_size > 0) {
+    fopts.xml_window_size = opts.xml_window_size;
+  }
+  fopts.part_workers = opts.office_part_workers;
+  fopts.lazy_sst = opts.lazy_sst;
+  if (opts.doc_main_text_only) {
+    fopts.doc_subdocs = msoffice::kDocSubdocMain;
+  }
 
   if (is_zip(data, len)) {
     msoffice::officex::ZipHelper zip;
@@ -144,30 +149,18 @@ doc2txt_result_t document2text(const char *data, size_t len,
   }
 
   msoffice::CompoundDocument comp_doc;
-  if (comp_doc.ParseFromBytes(data, len) != 0) {
+  if (comp_doc.ParseFromSpan({data, len}) != 0) {
     return kDoc2txtFail;
   }
 
   *type = opts.type;
   if (*type == kDocTypeUnknown) {
-    for (auto &i : comp_doc.GetDirEntries()) {
-      std::string dirname;
-      if (i.type == msoffice::kDirEntryTypeEmpty ||
-          msoffice::Utf16ToUtf8(i.unicode_name,
-                                i.unicode_name + i.name_len / 2 - 1,
-                                &dirname) != 0) {
-        continue;
-      }
-      if (dirname == "WordDocument") {
-        *type = kDocTypeDOC;
-        break;
-      } else if (dirname == "PowerPoint Document") {
-        *type = kDocTypePPT;
-        break;
-      } else if (dirname == "Workbook") {
-        *type = kDocTypeXLS;
-        break;
-      }
+    if (comp_doc.FindDirEntry(u"WordDocument") >= 0) {
+      *type = kDocTypeDOC;
+    } else if (comp_doc.FindDirEntry(u"PowerPoint Document") >= 0) {
+      *type = kDocTypePPT;
+    } else if (comp_doc.FindDirEntry(u"Workbook") >= 0) {
+      *type = kDocTypeXLS;
     }
   }
 
@@ -195,21 +188,309 @@ doc2txt_result_t document2text(const char *data, size_t len,
   return kDoc2txtOK;
 }
 
-int main(int argc, char **argv) {
-  assert(argc >= 2);
-  const char *filename = argv[1];
+Context::Context(const char *poppler_data_dir) {
+  simplepdf::Init(poppler_data_dir);
+}
+
+doc2txt_result_t Context::Convert(const char *data, size_t len,
+                                  const fetch_opts_t &opts, std::string *text,
+                                  document_type_t *type) const {
+  return document2text(data, len, opts, text, type);
+}
+
+// =============================================================================
+
+static const char *document_type_name(document_type_t type) {
+  switch (type) {
+    case kDocTypePDF:
+      return "pdf";
+    case kDocTypeDOC:
+      return "doc";
+    case kDocTypePPT:
+      return "ppt";
+    case kDocTypeXLS:
+      return "xls";
+    case kDocTypeDOCX:
+      return "docx";
+    case kDocTypePPTX:
+      return "pptx";
+    case kDocTypeXLSX:
+      return "xlsx";
+    default:
+      return "unknown";
+  }
+}
 
-  simplepdf::Init(nullptr);
+static const char *doc2txt_result_name(doc2txt_result_t res) {
+  switch (res) {
+    case kDoc2txtOK:
+      return "ok";
+    case kDoc2txtFail:
+      return "unsupported";
+    case kDoc2txtConvertErr:
+      return "convert_error";
+    default:
+      return "error";
+  }
+}
 
-  std::vector<char> data;
-  assert(utils::read_file(filename, &data) == 0);
-  fetch_opts_t opts = {
+struct batch_opts_t {
+  int jobs = 1;
+  bool tagged = false;
+  fetch_opts_t fetch = {
       .max_fetch_text_len = 40960,
       .max_fetch_pdf_page_cnt = 20,
   };
-  std::string text;
+};
+
+struct batch_result_t {
+  doc2txt_result_t res;
   document_type_t type;
-  assert(document2text(data.data(), data.size(), opts, &text, &type) == 0);
-  printf("%s", text.c_str());
+  const char *err;
+};
+
+// Writes results to stdout either in input order or, when tagged, as soon as
+// they are ready, each one prefixed with a header line naming its input:
+//   <index> TAB <status> TAB <type> TAB <text bytes> TAB <path> LF
+//   <text> LF
+class BatchWriter {
+ public:
+  BatchWriter(const std::vector<std::string> &paths, bool tagged)
+      : m_paths(paths), m_tagged(tagged), m_next(0) {}
+
+  void Write(size_t idx, const batch_result_t &r, const std::string &text) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (r.res != kDoc2txtOK) {
+      fprintf(stderr, "document2text: %s: %s\n", m_paths[idx].c_str(), r.err);
+    }
+
+    if (m_tagged) {
+      write_tagged(idx, r, text);
+    } else if (idx != m_next) {
+      m_pending[idx] = r.res == kDoc2txtOK ? text : std::string();
+    } else {
+      if (r.res == kDoc2txtOK) {
+        fwrite(text.data(), 1, text.size(), stdout);
+      }
+      for (m_next += 1;; m_next += 1) {
+        auto it = m_pending.find(m_next);
+        if (it == m_pending.end()) {
+          break;
+        }
+        fwrite(it->second.data(), 1, it->second.size(), stdout);
+        m_pending.erase(it);
+      }
+    }
+  }
+
+ private:
+  void write_tagged(size_t idx, const batch_result_t &r,
+                    const std::string &text) {
+    const std::string &t = r.res == kDoc2txtOK ? text : std::string();
+    fprintf(stdout, "%zu\t%s\t%s\t%zu\t%s\n", idx, doc2txt_result_name(r.res),
+            document_type_name(r.type), t.size(), m_paths[idx].c_str());
+    fwrite(t.data(), 1, t.size(), stdout);
+    fputc('\n', stdout);
+  }
+
+ private:
+  const std::vector<std::string> &m_paths;
+  bool m_tagged;
+  std::mutex m_mutex;
+  size_t m_next;
+  std::map<size_t, std::string> m_pending;
+};
+
+static batch_result_t convert_file(const Context &ctx,
+                                   const std::string &path,
+                                   const fetch_opts_t &opts,
+                                   std::string *text) {
+  batch_result_t r = {kDoc2txtFail, kDocTypeUnknown, "open failed"};
+  utils::MappedFile data;
+  if (data.Open(path.c_str()) != 0) {
+    return r;
+  }
+
+  try {
+    r.res = ctx.Convert(data.Data(), data.Size(), opts, text, &r.type);
+    r.err = r.res == kDoc2txtOK ? "" : doc2txt_result_name(r.res);
+  } catch (std::exception &ex) {
+    r.res = kDoc2txtConvertErr;
+    r.err = "exception";
+  }
+  return r;
+}
+
+static int run_batch(const Context &ctx,
+                     const std::vector<std::string> &paths,
+                     const batch_opts_t &opts) {
+  BatchWriter writer(paths, opts.tagged);
+  std::atomic<size_t> fail_cnt(0);
+
+  // Each worker reuses one output buffer across all of its files.
+  std::vector<std::string> texts(opts.jobs);
+  utils::ParallelFor(paths.size(), opts.jobs, [&](int worker, size_t idx) {
+    std::string &text = texts[worker];
+    text.clear();
+    auto r = convert_file(ctx, paths[idx], opts.fetch, &text);
+    if (r.res != kDoc2txtOK) {
+      fail_cnt += 1;
+    }
+    writer.Write(idx, r, text);
+  });
+  fflush(stdout);
+  return fail_cnt == 0 ? 0 : 1;
+}
+
+static int read_path_list(FILE *fp, char delimiter,
+                          std::vector<std::string> *paths) {
+  std::string path;
+  for (int ch; (ch = fgetc(fp)) != EOF;) {
+    if (ch != delimiter) {
+      path.push_back(ch);
+    } else if (!path.empty()) {
+      paths->push_back(std::move(path));
+      path.clear();
+    }
+  }
+  if (!path.empty()) {
+    paths->push_back(std::move(path));
+  }
+  return ferror(fp) ? -1 : 0;
+}
+
+static void report_path_error(const std::string &path,
+                              const std::error_code &ec) {
+  fprintf(stderr, "document2text: %s: %s\n", path.c_str(),
+          ec.message().c_str());
+}
+
+// Only a DIR that cannot be opened is fatal. Entries below it that cannot be
+// read, such as dangling links, are reported and skipped; subdirectories we
+// may not list are skipped. Links to directories are not followed.
+static int read_dir_paths(const char *dir, std::vector<std::string> *paths) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  fs::path curr = dir;
+  fs::directory_iterator it(curr, ec);
+  if (ec) {
+    report_path_error(curr.string(), ec);
+    return -1;
+  }
+
+  std::vector<std::string> found;
+  std::vector<fs::path> subdirs;
+  for (;;) {
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+      std::error_code entry_ec;
+      fs::file_status st = it->symlink_status(entry_ec);
+      if (!entry_ec && fs::is_directory(st)) {
+        subdirs.push_back(it->path());
+      } else if (!entry_ec && it->is_regular_file(entry_ec)) {
+        found.push_back(it->path().string());
+      }
+      if (entry_ec) {
+        report_path_error(it->path().string(), entry_ec);
+      }
+    }
+    if (ec) {
+      report_path_error(curr.string(), ec);
+      ec.clear();
+    }
+
+    if (subdirs.empty()) {
+      break;
+    }
+    curr = std::move(subdirs.back());
+    subdirs.pop_back();
+    it = fs::directory_iterator(
+        curr, fs::directory_options::skip_permission_denied, ec);
+  }
+
+  std::sort(found.begin(), found.end());
+  paths->insert(paths->end(), found.begin(), found.end());
   return 0;
 }
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [options] <file>...\n"
+          "       %s [options] -d <dir> | -l <list> | -0\n"
+          "  -d DIR  convert every regular file under DIR\n"
+          "  -l FILE convert the paths listed in FILE, one per line\n"
+          "  -0      read NUL-separated paths from stdin\n"
+          "  -j N    number of worker threads (default 1, 0 for all cores)\n"
+          "  -t      write tagged records instead of plain text\n"
+          "  -n LEN  max characters fetched from each document\n"
+          "  -p N    threads working on the pages or parts of each document\n"
+          "  -s      decode spreadsheet shared strings on demand\n"
+          "  -m      main text only for .doc, no notes/headers/comments\n",
+          name, name);
+}
+
+}  // namespace doc2txt
+
+int main(int argc, char **argv) {
+  doc2txt::batch_opts_t opts;
+  std::vector<std::string> paths;
+  for (int ch; (ch = getopt(argc, argv, "d:l:0j:tn:p:smh")) != -1;) {
+    switch (ch) {
+      case 'd':
+        if (doc2txt::read_dir_paths(optarg, &paths) != 0) {
+          return 2;
+        }
+        break;
+      case 'l': {
+        FILE *fp = fopen(optarg, "r");
+        if (fp == nullptr ||
+            doc2txt::read_path_list(fp, '\n', &paths) != 0) {
+          fprintf(stderr, "document2text: %s: %s\n", optarg, strerror(errno));
+          return 2;
+        }
+        fclose(fp);
+        break;
+      }
+      case '0':
+        if (doc2txt::read_path_list(stdin, '\0', &paths) != 0) {
+          fprintf(stderr, "document2text: stdin: %s\n", strerror(errno));
+          return 2;
+        }
+        break;
+      case 'j':
+        opts.jobs = atoi(optarg);
+        if (opts.jobs <= 0) {
+          opts.jobs = utils::HardwareConcurrency();
+        }
+        break;
+      case 't':
+        opts.tagged = true;
+        break;
+      case 'n':
+        opts.fetch.max_fetch_text_len = strtoull(optarg, nullptr, 10);
+        break;
+      case 'p':
+        opts.fetch.pdf_page_workers = atoi(optarg);
+        opts.fetch.office_part_workers = atoi(optarg);
+        break;
+      case 's':
+        opts.fetch.lazy_sst = true;
+        break;
+      case 'm':
+        opts.fetch.doc_main_text_only = true;
+        break;
+      default:
+        doc2txt::usage(argv[0]);
+        return 2;
+    }
+  }
+  for (int i = optind; i < argc; ++i) {
+    paths.push_back(argv[i]);
+  }
+  if (paths.empty()) {
+    doc2txt::usage(argv[0]);
+    return 2;
+  }
+
+  doc2txt::Context ctx;
+  return doc2txt::run_batch(ctx, paths, opts);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+
+namespace doc2txt {
+
+enum document_type_t {
+  kDocTypeUnknown = 0,
+  kDocTypePDF = 1,
+  kDocTypeDOC = 2,
+  kDocTypePPT = 3,
+  kDocTypeXLS = 4,
+  kDocTypeDOCX = 5,
+  kDocTypePPTX = 6,
+  kDocTypeXLSX = 7,
+};
+
+enum doc2txt_result_t {
+  kDoc2txtOK = 0,
+  kDoc2txtFail = -1,
+  kDoc2txtConvertErr = -2,
+};
+
+struct fetch_opts_t {
+  size_t max_fetch_text_len;
+  int max_fetch_pdf_page_cnt;
+  int max_xls_sst_cnt;
+  document_type_t type;
+  // Threads used to render the pages of one PDF; <= 1 renders them in turn.
+  int pdf_page_workers;
+  // Buffer size for streaming OOXML parts; 0 keeps the default (64 KB).
+  size_t xml_window_size;
+  // Threads parsing the parts of one Office document, e.g. XLS/XLSX sheets.
+  int office_part_workers;
+  // Decode XLS/XLSX shared strings only when a cell refers to them.
+  bool lazy_sst;
+  // Skip footnotes, headers, comments, endnotes and textboxes of .doc files.
+  bool doc_main_text_only;
+};
+
+// Entry point for embedding the converters.
+//
+// The constructor runs the process-wide setup (poppler's globalParams) once,
+// no matter how many contexts are created; the first poppler_data_dir wins.
+// Convert() keeps all of its scratch state in the call, so one context may be
+// shared by any number of threads.
+class Context {
+ public:
+  explicit Context(const char *poppler_data_dir = nullptr);
+
+  doc2txt_result_t Convert(const char *data, size_t len,
+                           const fetch_opts_t &opts, std::string *text,
+                           document_type_t *type) const;
+};
+
+}  // namespace doc2txt
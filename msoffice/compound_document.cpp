@@ -5,7 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-#include <cmath>
+#include <algorithm>
 
 #include "utils/utils.h"
 
@@ -58,14 +58,50 @@ bool is_big_endian(const compound_doc_header_t &hdr) {
   return hdr.byte_order == 0xfffe;
 }
 
+// Sector 0 starts after the 512-byte header, or after the whole first sector
+// when sectors are larger than that (4096 bytes in version 4).
 size_t sect_pos(const compound_doc_header_t &hdr, uint32_t sectid) {
-  return 512ul + static_cast<size_t>(sectid) * (1ul << hdr.ssz);
+  return std::max<size_t>(512, 1ul << hdr.ssz) +
+         (static_cast<size_t>(sectid) << hdr.ssz);
 }
 
 size_t short_sect_pos(const compound_doc_header_t &hdr, uint32_t sectid) {
   return static_cast<size_t>(sectid) * (1ul << hdr.sssz);
 }
 
+static std::u16string_view dir_entry_name(const directory_entry_t &dir) {
+  size_t len = dir.name_len / 2;
+  if (len == 0 || len > 32) {
+    return std::u16string_view();
+  }
+  return std::u16string_view(dir.unicode_name, len - 1);
+}
+
+// Only ASCII and Latin-1 letters are folded, which covers the names the
+// parsers look up; an entry ordered by a wider folding is still found by the
+// fallback scan in find_dir_child().
+static char16_t dir_name_upper(char16_t c) {
+  if ((c >= u'a' && c <= u'z') || (c >= 0xe0 && c <= 0xfe && c != 0xf7)) {
+    return c - 0x20;
+  }
+  return c;
+}
+
+// Directory order: shorter names first, then by upper-cased code units.
+static int compare_dir_names(std::u16string_view a, std::u16string_view b) {
+  if (a.size() != b.size()) {
+    return a.size() < b.size() ? -1 : 1;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    char16_t x = dir_name_upper(a[i]);
+    char16_t y = dir_name_upper(b[i]);
+    if (x != y) {
+      return x < y ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
 // =============================================================================
 
 void rc4_setup(rc4_state_t *state, const uint8_t *key, size_t klen) {
@@ -110,15 +146,97 @@ std::vector<uint8_t> rc4_crypt(rc4_state_t *state, const uint8_t *data,
 
 // =============================================================================
 
+StreamView::StreamView(const char *data, size_t size) : m_size(0) {
+  append(data, size);
+}
+
+void StreamView::append(const char *p, size_t len) {
+  if (len == 0) {
+    return;
+  }
+  if (!m_runs.empty() && m_runs.back().p + m_runs.back().len == p) {
+    m_runs.back().len += len;
+  } else {
+    m_runs.push_back({m_size, p, len});
+  }
+  m_size += len;
+}
+
+const StreamView::run_t *StreamView::find_run(size_t offset) const {
+  if (offset >= m_size) {
+    return nullptr;
+  }
+  auto it = std::upper_bound(
+      m_runs.begin(), m_runs.end(), offset,
+      [](size_t ofs, const run_t &r) { return ofs < r.offset; });
+  return &*(it - 1);
+}
+
+int StreamView::GetContiguous(size_t offset, const char **p,
+                              size_t *len) const {
+  auto run = find_run(offset);
+  if (run == nullptr) {
+    return -1;
+  }
+  *p = run->p + (offset - run->offset);
+  *len = run->len - (offset - run->offset);
+  return 0;
+}
+
+int StreamView::Read(size_t offset, size_t len, char *out) const {
+  if (offset > m_size || m_size - offset < len) {
+    return -1;
+  }
+  for (; len > 0;) {
+    const char *p;
+    size_t n;
+    if (GetContiguous(offset, &p, &n) != 0) {
+      return -1;
+    }
+    n = std::min(n, len);
+    memcpy(out, p, n);
+    out += n;
+    offset += n;
+    len -= n;
+  }
+  return 0;
+}
+
+int StreamView::Fetch(size_t offset, size_t len, std::vector<char> *buf,
+                      const char **p) const {
+  if (offset > m_size || m_size - offset < len) {
+    return -1;
+  }
+
+  size_t n;
+  if (len > 0 && GetContiguous(offset, p, &n) == 0 && n >= len) {
+    return 0;
+  }
+
+  buf->resize(len);
+  *p = buf->data();
+  return Read(offset, len, buf->data());
+}
+
+int StreamView::ReadAll(std::vector<char> *out) const {
+  out->resize(m_size);
+  return Read(0, m_size, out->data());
+}
+
+// =============================================================================
+
 const uint64_t CompoundDocument::_compound_document_doc_id = 0xE11AB1A1E011CFD0;
 
 int CompoundDocument::ParseFromFile(const std::string &filename) {
-  std::vector<char> data;
-  utils::read_file(filename.c_str(), &data);
-  if (data.size() < sizeof(compound_doc_header_t)) {
+  auto file = std::make_shared<utils::MappedFile>();
+  if (file->Open(filename.c_str()) != 0) {
     return -1;
   }
-  return ParseFromBytes(std::move(data));
+
+  m_data.clear();
+  m_view = {file->Data(), file->Size()};
+  m_file = std::move(file);
+  return parse();
 }
 
 int CompoundDocument::ParseFromBytes(const char *data, size_t data_len) {
@@ -127,68 +245,108 @@ int CompoundDocument::ParseFromBytes(const char *data, size_t data_len) {
   return ParseFromBytes(std::move(vec));
 }
 
-int CompoundDocument::get_master_sector_alloc_table(
-    const std::vector<char> &data, SectorAllocTable *msat) {
+int CompoundDocument::ParseFromSpan(std::span<const char> data) {
+  m_data.clear();
+  m_view = data;
+  m_file.reset();
+  return parse();
+}
+
+int CompoundDocument::parse() {
+  auto data = bytes();
+  if (data.size() < sizeof(compound_doc_header_t)) {
+    return -1;
+  }
+
   auto hdr = reinterpret_cast<const compound_doc_header_t *>(data.data());
-  for (int i = 0; i < 109; ++i) {
-    if (hdr->sec_ids[i] == -1) {
-      break;
-    }
-    msat->push_back(hdr->sec_ids[i]);
+  if (hdr->doc_id != _compound_document_doc_id) {
+    return -1;
+  }
+  // 512-byte sectors in version 3, 4096-byte in version 4; smaller ones
+  // still follow the 512-byte header.
+  if (hdr->ssz < 7 || hdr->ssz > 16 || hdr->sssz > hdr->ssz) {
+    return -1;
   }
 
-  int sec_cnt = std::ceil(static_cast<double>(data.size()) / (1 << hdr->ssz));
-  for (int32_t next_sec_id = hdr->sec_id_of_1st_sect_of_master_sect_alloc_table,
-               n = 0;
-       next_sec_id != kEndOfChainSecID &&
-       n < static_cast<int32_t>(
-               hdr->total_number_of_sect_used_for_master_sect_alloc_table) &&
-       n < sec_cnt;
-       ++n) {
-    const char *sec_p;
-    size_t size;
-    if (get_sector(data, next_sec_id, &sec_p, &size) != 0) {
-      return -1;
-    }
+  m_msat.clear();
+  m_ssat.clear();
+  m_dir_entries.clear();
+  m_dir_name_hashes.clear();
+  m_short_stream_chain.clear();
 
-    size_t cnt = (size - 4) / 4;
-    auto ids = reinterpret_cast<const int32_t *>(sec_p);
-    for (size_t i = 0; i < cnt; ++i) {
-      if (ids[i] != -1) {
-        break;
-      }
-      msat->push_back(ids[i]);
-    }
-    next_sec_id = ids[cnt];
+  if (get_master_sector_alloc_table(data, &m_msat) != 0) {
+    return -1;
+  }
+
+  if (get_short_sector_alloc_table(&m_ssat) != 0) {
+    return -1;
+  }
+
+  if (get_directory_entries(&m_dir_entries) != 0) {
+    return -1;
+  }
+  m_dir_name_hashes.reserve(m_dir_entries.size());
+  for (auto &dir : m_dir_entries) {
+    m_dir_name_hashes.push_back(dir_name_hash(dir_entry_name(dir)));
+  }
+
+  if (get_short_stream_chain(&m_short_stream_chain) != 0) {
+    return -1;
   }
   return 0;
 }
 
-int CompoundDocument::get_sector_alloc_table(const std::vector<char> &data,
-                                             const SectorAllocTable &msat,
-                                             SectorAllocTable *sat) {
-  for (auto sec_id : msat) {
+// The first 109 SAT sector ids are in the header, the rest in a chain of
+// MSAT sectors whose last id links to the next one.
+int CompoundDocument::get_master_sector_alloc_table(std::span<const char> data,
+                                                    SectorAllocTable *msat) {
+  auto hdr = reinterpret_cast<const compound_doc_header_t *>(data.data());
+  size_t sec_size = 1ul << hdr->ssz;
+  size_t sec_cnt = (data.size() + sec_size - 1) >> hdr->ssz;
+  size_t sat_cnt = std::min(
+      static_cast<size_t>(hdr->total_number_of_sect_used_for_sect_alloc_table),
+      sec_cnt);
+  msat->reserve(sat_cnt);
+
+  for (int i = 0; i < 109 && msat->size() < sat_cnt; ++i) {
+    if (hdr->sec_ids[i] < 0) {
+      break;
+    }
+    msat->push_back(hdr->sec_ids[i]);
+  }
+
+  size_t msat_cnt =
+      hdr->total_number_of_sect_used_for_master_sect_alloc_table;
+  for (int32_t next_sec_id = hdr->sec_id_of_1st_sect_of_master_sect_alloc_table;
+       next_sec_id >= 0 && msat->size() < sat_cnt && msat_cnt > 0;
+       --msat_cnt) {
     const char *sec_p;
     size_t size;
-    if (get_sector(data, sec_id, &sec_p, &size) != 0) {
+    if (get_sector(data, next_sec_id, &sec_p, &size) != 0 || size < sec_size) {
       return -1;
     }
 
-    size_t cnt = size / 4;
+    size_t cnt = size / 4 - 1;
     auto ids = reinterpret_cast<const int32_t *>(sec_p);
-    for (size_t i = 0; i < cnt; ++i) {
-      sat->push_back(ids[i]);
+    for (size_t i = 0; i < cnt && msat->size() < sat_cnt; ++i) {
+      if (ids[i] >= 0) {
+        msat->push_back(ids[i]);
+      }
     }
+    next_sec_id = ids[cnt];
   }
   return 0;
 }
 
-int CompoundDocument::get_sector(const std::vector<char> &data, int32_t sec_id,
+int CompoundDocument::get_sector(std::span<const char> data, int32_t sec_id,
                                  const char **p, size_t *size) {
   auto hdr = reinterpret_cast<const compound_doc_header_t *>(data.data());
+  if (sec_id < 0) {
+    return -1;
+  }
   *size = 1ul << hdr->ssz;
 
-  size_t pos = 512ul + static_cast<size_t>(sec_id) * *size;
+  size_t pos = sect_pos(*hdr, sec_id);
   if (pos >= data.size()) {
     return -1;
   }
@@ -200,30 +358,46 @@ int CompoundDocument::get_sector(const std::vector<char> &data, int32_t sec_id,
 }
 
 int CompoundDocument::get_short_stream_sector(
-    const compound_doc_header_t *hdr,
-    const std::vector<char> &short_stream_data, int32_t sec_id, const char **p,
-    size_t *size) {
-  *size = 1ul << hdr->sssz;
+    std::span<const char> data, const StreamSecIdChain &short_stream_chain,
+    int32_t sec_id, const char **p, size_t *size) {
+  auto hdr = reinterpret_cast<const compound_doc_header_t *>(data.data());
+  if (sec_id < 0 || hdr->sssz > hdr->ssz) {
+    return -1;
+  }
+
+  // A short sector never straddles two sectors of the short stream, since
+  // both sizes are powers of two, so map it onto its container sector.
+  size_t pos = static_cast<size_t>(sec_id) << hdr->sssz;
+  size_t idx = pos >> hdr->ssz;
+  if (idx >= short_stream_chain.size()) {
+    return -1;
+  }
 
-  size_t pos = static_cast<size_t>(sec_id) * *size;
-  if (*size > short_stream_data.size() ||
-      pos + *size > short_stream_data.size()) {
+  const char *sec_p;
+  size_t sec_size;
+  if (get_sector(data, short_stream_chain[idx], &sec_p, &sec_size) != 0) {
     return -1;
   }
-  *p = short_stream_data.data() + pos;
+
+  size_t offset = pos & ((1ul << hdr->ssz) - 1);
+  *size = 1ul << hdr->sssz;
+  if (offset + *size > sec_size) {
+    return -1;
+  }
+  *p = sec_p + offset;
   return 0;
 }
 
 int CompoundDocument::get_short_sector_alloc_table(
-    const std::vector<char> &data, const SectorAllocTable &sat,
-    SectorAllocTable *ssat) {
-  auto hdr = reinterpret_cast<const compound_doc_header_t *>(data.data());
+    SectorAllocTable *ssat) const {
+  auto data = bytes();
+  auto hdr = GetHeader();
   if (hdr->sec_id_of_1st_sect_of_ss_alloc_table < 0) {
     return 0;
   }
 
   std::vector<int32_t> chain;
-  if (get_sec_ids_chain(hdr->sec_id_of_1st_sect_of_ss_alloc_table, sat,
+  if (get_sec_ids_chain(hdr->sec_id_of_1st_sect_of_ss_alloc_table, false,
                         &chain) != 0) {
     return -1;
   }
@@ -246,12 +420,11 @@ int CompoundDocument::get_short_sector_alloc_table(
 }
 
 int CompoundDocument::get_directory_entries(
-    const std::vector<char> &data, const SectorAllocTable &sat,
-    std::vector<directory_entry_t> *dir_entries) {
-  auto hdr = reinterpret_cast<const compound_doc_header_t *>(data.data());
+    std::vector<directory_entry_t> *dir_entries) const {
+  auto data = bytes();
   std::vector<int32_t> chain;
-  if (get_sec_ids_chain(hdr->sec_id_of_1st_sect_of_dir_stream, sat, &chain) !=
-      0) {
+  if (get_sec_ids_chain(GetHeader()->sec_id_of_1st_sect_of_dir_stream, false,
+                        &chain) != 0) {
     return -1;
   }
 
@@ -272,12 +445,10 @@ int CompoundDocument::get_directory_entries(
   return 0;
 }
 
-int CompoundDocument::get_short_stream_data(
-    const std::vector<char> &data, const SectorAllocTable &ssat,
-    const std::vector<directory_entry_t> &dir_entries,
-    std::vector<char> *short_stream_data) {
+int CompoundDocument::get_short_stream_chain(
+    StreamSecIdChain *short_stream_chain) const {
   int32_t first_short_sec_id = kFreeSecID;
-  for (auto &dir : dir_entries) {
+  for (auto &dir : m_dir_entries) {
     if (dir.type == kDirEntryTypeRootStorage) {
       first_short_sec_id = dir.sec_id_of_1st_x;
       break;
@@ -290,121 +461,242 @@ int CompoundDocument::get_short_stream_data(
     return 0;
   }
 
-  std::vector<int32_t> chain;
-  if (get_sec_ids_chain(first_short_sec_id, ssat, &chain) != 0) {
+  return get_sec_ids_chain(first_short_sec_id, false, short_stream_chain);
+}
+
+int CompoundDocument::get_sat_entry(sat_cursor_t *cursor, int32_t sec_id,
+                                    int32_t *next_sec_id) const {
+  if (sec_id < 0) {
     return -1;
   }
 
-  auto hdr = reinterpret_cast<const compound_doc_header_t *>(data.data());
-  size_t sec_size = 1ul << hdr->ssz;
-  short_stream_data->resize(sec_size * chain.size());
-  char *p = short_stream_data->data();
-  for (int32_t sec_id : chain) {
+  size_t ids_per_sec = (1ul << GetHeader()->ssz) / sizeof(int32_t);
+  size_t idx = static_cast<size_t>(sec_id) / ids_per_sec;
+  if (idx != cursor->idx) {
     const char *sec_p;
     size_t size;
-    if (get_sector(data, sec_id, &sec_p, &size) != 0) {
+    if (idx >= m_msat.size() ||
+        get_sector(bytes(), m_msat[idx], &sec_p, &size) != 0) {
       return -1;
     }
-    memcpy(p, sec_p, size);
-    p += size;
+    cursor->idx = idx;
+    cursor->ids = reinterpret_cast<const int32_t *>(sec_p);
+    cursor->cnt = size / sizeof(int32_t);
   }
 
+  size_t i = static_cast<size_t>(sec_id) % ids_per_sec;
+  if (i >= cursor->cnt) {
+    return -1;
+  }
+  *next_sec_id = cursor->ids[i];
   return 0;
 }
 
-int CompoundDocument::get_stream(int32_t first_sec_id,
-                                 const SectorAllocTable &xsat,
-                                 get_sec_ids_t func,
-                                 std::vector<char> *stream) const {
-  std::vector<int32_t> chain;
-  if (get_sec_ids_chain(first_sec_id, xsat, &chain) != 0) {
+int CompoundDocument::get_next_sec_id(sat_cursor_t *cursor, bool is_short,
+                                      int32_t sec_id,
+                                      int32_t *next_sec_id) const {
+  if (!is_short) {
+    return get_sat_entry(cursor, sec_id, next_sec_id);
+  }
+  if (sec_id < 0 || static_cast<size_t>(sec_id) >= m_ssat.size()) {
     return -1;
   }
+  *next_sec_id = m_ssat[sec_id];
+  return 0;
+}
+
+size_t CompoundDocument::max_chain_len(bool is_short) const {
+  if (is_short) {
+    return m_ssat.size();
+  }
+  auto hdr = GetHeader();
+  size_t sec_cnt = (bytes().size() + (1ul << hdr->ssz) - 1) >> hdr->ssz;
+  size_t ids_per_sec = (1ul << hdr->ssz) / sizeof(int32_t);
+  return std::min(sec_cnt, m_msat.size() * ids_per_sec);
+}
 
-  char *p = stream->data();
-  size_t plen = stream->size();
+// Only the links up to `size` bytes are followed, so the cost is that of the
+// sectors actually mapped rather than of the whole SAT.
+int CompoundDocument::get_stream_view(int32_t first_sec_id, size_t size,
+                                      bool is_short, StreamView *view) const {
+  get_sec_ids_t func = is_short ? &CompoundDocument::GetShortStreamSector
+                                : &CompoundDocument::GetSector;
+  size_t max_len = max_chain_len(is_short);
+
+  *view = StreamView();
+  sat_cursor_t cursor;
+  size_t len = 0;
+  for (int32_t sec_id = first_sec_id;
+       sec_id != kEndOfChainSecID && view->m_size < size;) {
+    if (++len > max_len) {
+      return -1;
+    }
 
-  for (auto sec_id : chain) {
     const char *sec_p;
-    size_t size;
-    if ((this->*func)(sec_id, &sec_p, &size) != 0) {
+    size_t sec_size;
+    if ((this->*func)(sec_id, &sec_p, &sec_size) != 0) {
       return -1;
     }
+    view->append(sec_p, std::min(sec_size, size - view->m_size));
 
-    size_t len = std::min(size, plen);
-    memcpy(p, sec_p, len);
-    p += len;
-    plen -= len;
+    if (view->m_size < size &&
+        get_next_sec_id(&cursor, is_short, sec_id, &sec_id) != 0) {
+      return -1;
+    }
   }
   return 0;
 }
 
-int CompoundDocument::get_sec_ids_chain(int32_t first_xsec_id,
-                                        const SectorAllocTable &xsat,
-                                        std::vector<int32_t> *chain) {
-  for (int32_t sec_id = first_xsec_id; sec_id != kEndOfChainSecID;
-       sec_id = xsat[chain->back()]) {
-    if (sec_id < 0 || sec_id >= static_cast<int>(xsat.size())) {
+int CompoundDocument::get_sec_ids_chain(int32_t first_sec_id, bool is_short,
+                                        std::vector<int32_t> *chain) const {
+  size_t max_len = max_chain_len(is_short);
+  sat_cursor_t cursor;
+  for (int32_t sec_id = first_sec_id; sec_id != kEndOfChainSecID;) {
+    if (chain->size() >= max_len) {
       return -1;
     }
-
     chain->push_back(sec_id);
-    if (chain->size() > xsat.size()) {
+    if (get_next_sec_id(&cursor, is_short, sec_id, &sec_id) != 0) {
       return -1;
     }
   }
   return 0;
 }
 
+int CompoundDocument::GetSATEntry(int32_t sec_id, int32_t *next_sec_id) const {
+  sat_cursor_t cursor;
+  return get_sat_entry(&cursor, sec_id, next_sec_id);
+}
+
 int CompoundDocument::GetDirEntryStream(const directory_entry_t &dir_entry,
                                         std::vector<char> *stream) const {
-  if (dir_entry.sec_id_of_1st_x < 0) {
+  StreamView view;
+  if (GetDirEntryStreamView(dir_entry, &view) != 0) {
+    return -1;
+  }
+
+  stream->assign(GetDirEntryStreamSize(dir_entry), 0);
+  return view.Read(0, view.Size(), stream->data());
+}
+
+uint64_t CompoundDocument::GetDirEntryStreamSize(
+    const directory_entry_t &dir_entry) const {
+  uint64_t size = dir_entry.size_of_x;
+  if (GetHeader()->version >= 4) {
+    size |= static_cast<uint64_t>(dir_entry.size_of_x_high) << 32;
+  }
+  return size;
+}
+
+int CompoundDocument::GetDirEntryStreamView(const directory_entry_t &dir_entry,
+                                            StreamView *view) const {
+  return GetDirEntryStreamView(dir_entry, UINT64_MAX, view);
+}
+
+int CompoundDocument::GetDirEntryStreamView(const directory_entry_t &dir_entry,
+                                            uint64_t max_size,
+                                            StreamView *view) const {
+  uint64_t size = GetDirEntryStreamSize(dir_entry);
+  if (dir_entry.sec_id_of_1st_x < 0 || size > bytes().size()) {
+    return -1;
+  }
+
+  auto hdr = GetHeader();
+  bool is_short = size < hdr->min_size_of_std_stream;
+  return get_stream_view(dir_entry.sec_id_of_1st_x, std::min(size, max_size),
+                         is_short, view);
+}
+
+// FNV-1a over the upper-cased name, so equal names hash equally.
+uint32_t CompoundDocument::dir_name_hash(std::u16string_view name) {
+  uint32_t hash = 2166136261u;
+  for (char16_t c : name) {
+    hash = (hash ^ dir_name_upper(c)) * 16777619u;
+  }
+  return hash;
+}
+
+int CompoundDocument::find_dir_child(int storage_idx,
+                                     std::u16string_view name) const {
+  auto &dirs = m_dir_entries;
+  int idx = dirs[storage_idx].root_dir_id;
+  for (size_t steps = 0;
+       idx >= 0 && static_cast<size_t>(idx) < dirs.size() &&
+       steps < dirs.size();
+       ++steps) {
+    int cmp = compare_dir_names(name, dir_entry_name(dirs[idx]));
+    if (cmp == 0) {
+      return dirs[idx].type != kDirEntryTypeEmpty ? idx : -1;
+    }
+    idx = cmp < 0 ? dirs[idx].left_child_dir_id : dirs[idx].right_child_dir_id;
+  }
+
+  // Some writers leave the tree unsorted, fall back to visiting every sibling
+  // in it. Entries of nested storages are not siblings and are not visited.
+  uint32_t hash = dir_name_hash(name);
+  std::vector<bool> visited(dirs.size());
+  std::vector<int> pending(1, dirs[storage_idx].root_dir_id);
+  while (!pending.empty()) {
+    int i = pending.back();
+    pending.pop_back();
+    if (i < 0 || static_cast<size_t>(i) >= dirs.size() || visited[i]) {
+      continue;
+    }
+    visited[i] = true;
+
+    if (m_dir_name_hashes[i] == hash && dirs[i].type != kDirEntryTypeEmpty &&
+        compare_dir_names(name, dir_entry_name(dirs[i])) == 0) {
+      return i;
+    }
+    pending.push_back(dirs[i].left_child_dir_id);
+    pending.push_back(dirs[i].right_child_dir_id);
+  }
+  return -1;
+}
+
+int CompoundDocument::FindDirEntry(std::u16string_view path) const {
+  if (m_dir_entries.empty()) {
     return -1;
   }
 
-  auto hdr = reinterpret_cast<const compound_doc_header_t *>(m_data.data());
-  stream->resize(dir_entry.size_of_x);
-  return get_stream(
-      dir_entry.sec_id_of_1st_x,
-      dir_entry.size_of_x < static_cast<int>(hdr->min_size_of_std_stream)
-          ? m_ssat
-          : m_sat,
-      dir_entry.size_of_x < static_cast<int>(hdr->min_size_of_std_stream)
-          ? &CompoundDocument::GetShortStreamSector
-          : &CompoundDocument::GetSector,
-      stream);
+  int idx = 0;
+  while (!path.empty()) {
+    size_t n = path.find(u'/');
+    auto name = path.substr(0, n);
+    path = n == std::u16string_view::npos ? std::u16string_view()
+                                          : path.substr(n + 1);
+
+    uint8_t type = m_dir_entries[idx].type;
+    if (type != kDirEntryTypeRootStorage && type != kDirEntryTypeUserStorage) {
+      return -1;
+    }
+    if ((idx = find_dir_child(idx, name)) < 0) {
+      return -1;
+    }
+  }
+  return idx;
 }
 
 std::set<int> CompoundDocument::GetValidDirIndex() const {
   std::set<int> res;
-  // if (m_dir_entries.empty()) {
-  //   return res;
-  // }
-
-  // std::vector<int> idx;
-  // idx.reserve(m_dir_entries.size());
-  // idx.push_back(0);
-
-  // for (size_t i = 0; i < idx.size(); ++i) {
-  //   res.insert(idx[i]);
-  //   auto &dir = m_dir_entries[idx[i]];
-  //   xmlog(Debug, "%d, %d", idx[i], m_sat[dir.sec_id_of_1st_x]);
-
-  //   if (dir.root_dir_id != -1 && dir.root_dir_id < m_dir_entries.size() &&
-  //       res.find(dir.root_dir_id) == res.end()) {
-  //     idx.push_back(dir.root_dir_id);
-  //   }
-  //   if (dir.left_child_dir_id != -1 &&
-  //       dir.left_child_dir_id < m_dir_entries.size() &&
-  //       res.find(dir.left_child_dir_id) == res.end()) {
-  //     idx.push_back(dir.left_child_dir_id);
-  //   }
-  //   if (dir.right_child_dir_id != -1 &&
-  //       dir.right_child_dir_id < m_dir_entries.size() &&
-  //       res.find(dir.right_child_dir_id) == res.end()) {
-  //     idx.push_back(dir.right_child_dir_id);
-  //   }
-  // }
+  std::vector<int> pending;
+  if (!m_dir_entries.empty()) {
+    pending.push_back(0);
+  }
+
+  while (!pending.empty()) {
+    int idx = pending.back();
+    pending.pop_back();
+    if (idx < 0 || static_cast<size_t>(idx) >= m_dir_entries.size() ||
+        !res.insert(idx).second) {
+      continue;
+    }
+
+    auto &dir = m_dir_entries[idx];
+    pending.push_back(dir.root_dir_id);
+    pending.push_back(dir.left_child_dir_id);
+    pending.push_back(dir.right_child_dir_id);
+  }
   return res;
 }
 
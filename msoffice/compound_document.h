@@ -2,10 +2,15 @@
 
 #include <stdint.h>
 
+#include <memory>
 #include <set>
+#include <span>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "utils/utils.h"
+
 namespace msoffice {
 
 template <typename T>
@@ -81,10 +86,52 @@ struct directory_entry_t {
   uint64_t ctime;
   uint64_t mtime;
   int32_t sec_id_of_1st_x;
-  int32_t size_of_x;
-  char unused[4];
+  uint32_t size_of_x;
+  // High half of a 64-bit stream size; only meaningful in version 4 files,
+  // version 3 writers may leave garbage here.
+  uint32_t size_of_x_high;
 } __attribute__((packed));
 
+// Read-only view over the bytes of one stream, served straight from the
+// sectors of its chain. Sequential sectors are merged into contiguous runs.
+class StreamView {
+ public:
+  StreamView() : m_size(0) {}
+  StreamView(const char* data, size_t size);
+
+  inline size_t Size() const {
+    return m_size;
+  }
+
+  // Longest contiguous run of bytes starting at `offset`.
+  int GetContiguous(size_t offset, const char** p, size_t* len) const;
+
+  int Read(size_t offset, size_t len, char* out) const;
+
+  // Points `*p` at [offset, offset + len). No copy is made when the range
+  // lies in one run, otherwise the bytes are gathered into `buf`.
+  int Fetch(size_t offset, size_t len, std::vector<char>* buf,
+            const char** p) const;
+
+  int ReadAll(std::vector<char>* out) const;
+
+ private:
+  friend class CompoundDocument;
+
+  struct run_t {
+    size_t offset;
+    const char* p;
+    size_t len;
+  };
+
+  void append(const char* p, size_t len);
+  const run_t* find_run(size_t offset) const;
+
+ private:
+  std::vector<run_t> m_runs;
+  size_t m_size;
+};
+
 class CompoundDocument {
  public:
   using SectorAllocTable = std::vector<int32_t>;
@@ -94,72 +141,70 @@ class CompoundDocument {
   int ParseFromFile(const std::string& filename);
   int ParseFromBytes(const char* data, size_t data_len);
 
+  // Parse over caller-owned bytes without copying them, the caller must keep
+  // `data` alive as long as this document (and any copy of it) is used.
+  int ParseFromSpan(std::span<const char> data);
+
   template <typename _T,
             typename std::enable_if<is_bytes<_T>::value>::type* = nullptr>
   int ParseFromBytes(_T&& data) {
-    auto hdr = reinterpret_cast<compound_doc_header_t*>(data.data());
-    if (hdr->doc_id != _compound_document_doc_id) {
-      return -1;
-    }
-
-    if (get_master_sector_alloc_table(data, &this->m_msat) != 0) {
-      return -1;
-    }
-
-    if (get_sector_alloc_table(data, this->m_msat, &this->m_sat) != 0) {
-      return -1;
-    }
-
-    if (get_short_sector_alloc_table(data, this->m_sat, &this->m_ssat) != 0) {
-      return -1;
-    }
-
-    if (get_directory_entries(data, this->m_sat, &this->m_dir_entries) != 0) {
-      return -1;
-    }
-
-    if (get_short_stream_data(data, this->m_sat, this->m_dir_entries,
-                              &this->m_short_stream_data) != 0) {
-      return -1;
-    }
-
-    this->m_data = std::forward<_T>(data);
-    return 0;
+    m_data = std::forward<_T>(data);
+    m_view = {};
+    m_file.reset();
+    return parse();
   }
 
   inline const compound_doc_header_t* GetHeader() const {
-    return reinterpret_cast<const compound_doc_header_t*>(m_data.data());
+    return reinterpret_cast<const compound_doc_header_t*>(bytes().data());
   }
 
   inline const SectorAllocTable& GetMSAT() const {
     return m_msat;
   }
 
-  inline const SectorAllocTable& GetSAT() const {
-    return m_sat;
-  }
+  // The SAT is not kept in memory, each link is read from the SAT sector
+  // holding it.
+  int GetSATEntry(int32_t sec_id, int32_t* next_sec_id) const;
 
   inline const SectorAllocTable& GetSSAT() const {
     return m_ssat;
   }
 
-  inline const std::vector<directory_entry_t> GetDirEntries() const {
+  inline const std::vector<directory_entry_t>& GetDirEntries() const {
     return m_dir_entries;
   }
 
+  // Index of the entry at `path` ("Storage/Stream"), found through the
+  // red-black tree of each storage on the way. Names compare the way the
+  // spec orders them, case-insensitively. -1 if there is no such entry.
+  int FindDirEntry(std::u16string_view path) const;
+
   inline int GetSector(int32_t sec_id, const char** p, size_t* size) const {
-    return get_sector(m_data, sec_id, p, size);
+    return get_sector(bytes(), sec_id, p, size);
   }
 
   inline int GetShortStreamSector(int32_t sec_id, const char** p,
                                   size_t* size) const {
-    auto hdr = reinterpret_cast<const compound_doc_header_t*>(m_data.data());
-    return get_short_stream_sector(hdr, m_short_stream_data, sec_id, p, size);
+    return get_short_stream_sector(bytes(), m_short_stream_chain, sec_id, p,
+                                   size);
   }
 
+  // Size of the stream of a directory entry.
+  uint64_t GetDirEntryStreamSize(const directory_entry_t& dir_entry) const;
+
   int GetDirEntryStream(const directory_entry_t& dir_entry,
                         std::vector<char>* stream) const;
 
+  // The view borrows this document's bytes, it must not outlive them.
+  int GetDirEntryStreamView(const directory_entry_t& dir_entry,
+                            StreamView* view) const;
+
+  // Maps no more than the first `max_size` bytes, so the chain is followed
+  // only as far as the caller reads.
+  int GetDirEntryStreamView(const directory_entry_t& dir_entry,
+                            uint64_t max_size, StreamView* view) const;
+
+  // Entries reachable from the root storage.
   std::set<int> GetValidDirIndex() const;
 
  private:
@@ -168,48 +213,66 @@ class CompoundDocument {
   using get_sec_ids_t = int (CompoundDocument::*)(int32_t, const char**,
                                                   size_t*) const;
 
-  int get_stream(int32_t first_sec_id, const SectorAllocTable& xsat,
-                 get_sec_ids_t func, std::vector<char>* stream) const;
+  // The SAT sector a chain walk read its last link from, so following a
+  // chain through one SAT sector maps it only once.
+  struct sat_cursor_t {
+    size_t idx = SIZE_MAX;
+    const int32_t* ids = nullptr;
+    size_t cnt = 0;
+  };
+
+  // Owned bytes win over the borrowed view, so a copied document never
+  // points into another document's buffer.
+  inline std::span<const char> bytes() const {
+    return m_data.empty() ? m_view : std::span<const char>(m_data);
+  }
 
-  static int get_master_sector_alloc_table(const std::vector<char>& data,
-                                           SectorAllocTable* msat);
+  int parse();
 
-  static int get_sector_alloc_table(const std::vector<char>& data,
-                                    const SectorAllocTable& msat,
-                                    SectorAllocTable* sat);
+  int get_stream_view(int32_t first_sec_id, size_t size, bool is_short,
+                      StreamView* view) const;
 
-  static int get_short_sector_alloc_table(const std::vector<char>& data,
-                                          const SectorAllocTable& sat,
-                                          SectorAllocTable* ssat);
+  static int get_master_sector_alloc_table(std::span<const char> data,
+                                           SectorAllocTable* msat);
+
+  int get_short_sector_alloc_table(SectorAllocTable* ssat) const;
 
-  static int get_sector(const std::vector<char>& data, int32_t sec_id,
+  static int get_sector(std::span<const char> data, int32_t sec_id,
                         const char** p, size_t* size);
 
-  static int get_short_stream_sector(const compound_doc_header_t* hdr,
-                                     const std::vector<char>& short_stream_data,
-                                     int32_t sec_id, const char** p,
-                                     size_t* size);
+  static int get_short_stream_sector(
+      std::span<const char> data, const StreamSecIdChain& short_stream_chain,
+      int32_t sec_id, const char** p, size_t* size);
+
+  int get_directory_entries(std::vector<directory_entry_t>* dir_entries) const;
+
+  int get_short_stream_chain(StreamSecIdChain* short_stream_chain) const;
+
+  static uint32_t dir_name_hash(std::u16string_view name);
+
+  int find_dir_child(int storage_idx, std::u16string_view name) const;
+
+  int get_sat_entry(sat_cursor_t* cursor, int32_t sec_id,
+                    int32_t* next_sec_id) const;
 
-  static int get_directory_entries(const std::vector<char>& data,
-                                   const SectorAllocTable& sat,
-                                   std::vector<directory_entry_t>* dir_entries);
+  int get_next_sec_id(sat_cursor_t* cursor, bool is_short, int32_t sec_id,
+                      int32_t* next_sec_id) const;
 
-  static int get_short_stream_data(
-      const std::vector<char>& data, const SectorAllocTable& ssat,
-      const std::vector<directory_entry_t>& dir_entries,
-      std::vector<char>* short_stream_data);
+  // Upper bound on the length of a sane chain.
+  size_t max_chain_len(bool is_short) const;
 
-  static int get_sec_ids_chain(int32_t first_xsec_id,
-                               const SectorAllocTable& xsat,
-                               std::vector<int32_t>* chain);
+  int get_sec_ids_chain(int32_t first_sec_id, bool is_short,
+                        std::vector<int32_t>* chain) const;
 
  private:
   std::vector<char> m_data;
-  std::vector<char> m_short_stream_data;
+  std::span<const char> m_view;
+  std::shared_ptr<utils::MappedFile> m_file;
+  StreamSecIdChain m_short_stream_chain;
   SectorAllocTable m_msat;
-  SectorAllocTable m_sat;
   SectorAllocTable m_ssat;
   std::vector<directory_entry_t> m_dir_entries;
+  std::vector<uint32_t> m_dir_name_hashes;
 };
 
 template <typename T>
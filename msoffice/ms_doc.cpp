@@ -2,6 +2,9 @@
 
 #include <string.h>
 
+#include <algorithm>
+#include <limits>
+
 #include "utils/utils.h"
 
 #define CONCAT_(_A, _B) _A##_B
@@ -13,44 +16,32 @@ namespace msoffice {
 
 namespace doc {
 
-static const std::string g_0TableDirName = "0Table";
-static const std::string g_1TableDirName = "1Table";
-static const std::string g_WordDocDirName = "WordDocument";
-
-int PlcPcd::ParseFrom(const FibRgFcLcb97_t &fib_rg_fc_lcb97,
-                      const std::vector<char> &table_stream) {
-  const char *clx_ptr = table_stream.data() + fib_rg_fc_lcb97.fcClx;
-  const char *pcdt_ptr = nullptr;
-
-  const char *clx_m_ptr = clx_ptr;
-#define clxt reinterpret_cast<const uint8_t *>(clx_m_ptr)
-  for (; clx_m_ptr < table_stream.data() + table_stream.size() &&
-         *clxt == 0x01;) {
-    auto cbGrpprl = reinterpret_cast<const int16_t *>(clx_m_ptr + 1);
-    clx_m_ptr += 1 + 2 + *cbGrpprl;
-  }
-
-  if (clx_m_ptr < table_stream.data() + table_stream.size()) {
-    if (*clxt == 0x02) {
-      pcdt_ptr = clx_ptr;
-    } else if (*clxt == 0x01) {
-      auto cb_grpprl = reinterpret_cast<const int16_t *>(clxt + 1);
-      pcdt_ptr = clx_ptr + 1 + *cb_grpprl;
-    } else {
+static const std::u16string_view g_0TableDirName = u"0Table";
+static const std::u16string_view g_1TableDirName = u"1Table";
+static const std::u16string_view g_WordDocDirName = u"WordDocument";
+
+int PlcPcd::ParseFrom(const char *clx, size_t clx_len) {
+  size_t offset = 0;
+  for (; offset < clx_len && static_cast<uint8_t>(clx[offset]) == 0x01;) {
+    if (offset + 1 + sizeof(int16_t) > clx_len) {
       return -1;
     }
-  } else {
-    return -1;
+    auto cbGrpprl = reinterpret_cast<const int16_t *>(clx + offset + 1);
+    if (*cbGrpprl < 0) {
+      return -1;
+    }
+    offset += 1 + sizeof(int16_t) + *cbGrpprl;
   }
-#undef clxt
 
-  if (pcdt_ptr - table_stream.data() + 1 + sizeof(uint32_t) >
-      table_stream.size()) {
+  if (offset + 1 + sizeof(uint32_t) > clx_len ||
+      static_cast<uint8_t>(clx[offset]) != 0x02) {
     return -1;
   }
+  const char *pcdt_ptr = clx + offset;
+
   auto lcb = reinterpret_cast<const uint32_t *>(pcdt_ptr + 1);
-  if (clx_ptr + fib_rg_fc_lcb97.lcbClx !=
-          pcdt_ptr + 1 + sizeof(uint32_t) + *lcb ||
+  if (offset + 1 + sizeof(uint32_t) + *lcb != clx_len ||
+      *lcb < sizeof(int32_t) ||
       (*lcb - sizeof(int32_t)) % (sizeof(int32_t) + sizeof(Pcd_t)) != 0) {
     return -1;
   }
@@ -73,50 +64,109 @@ int PlcPcd::ParseFrom(const FibRgFcLcb97_t &fib_rg_fc_lcb97,
 
 // =============================================================================
 
+struct piece_read_t {
+  size_t offset;
+  size_t len;
+  size_t cch;
+  bool compressed;
+  size_t range;
+};
+
+struct read_range_t {
+  size_t offset;
+  size_t len;
+  const char *p;
+};
+
+struct cp_range_t {
+  int64_t begin;
+  int64_t end;
+};
+
+// CP ranges of the selected subdocuments, merged where they touch. They
+// follow the main text in the order of doc_subdoc_t, with the unused macro
+// subdocument between headers and comments. Selecting all of them keeps the
+// whole CP space, including whatever trails the counted text.
+static void select_subdoc_cps(const FibRgLw97_t &lw, uint32_t subdocs,
+                              std::vector<cp_range_t> *cps) {
+  cps->clear();
+  if ((subdocs & kDocSubdocAll) == kDocSubdocAll) {
+    cps->push_back({std::numeric_limits<int64_t>::min(),
+                    std::numeric_limits<int64_t>::max()});
+    return;
+  }
+
+  const struct {
+    uint32_t ccp;
+    uint32_t subdoc;
+  } parts[] = {
+      {lw.ccpText, kDocSubdocMain},
+      {lw.ccpFtn, kDocSubdocFootnotes},
+      {lw.ccpHdd, kDocSubdocHeaders},
+      {lw.reserved3, 0},
+      {lw.ccpAtn, kDocSubdocComments},
+      {lw.ccpEdn, kDocSubdocEndnotes},
+      {lw.ccpTxbx, kDocSubdocTextboxes},
+      {lw.ccpHdrTxbx, kDocSubdocHeaderTextboxes},
+  };
+  int64_t cp = 0;
+  for (auto &part : parts) {
+    int64_t end = cp + part.ccp;
+    if ((subdocs & part.subdoc) != 0 && end > cp) {
+      if (!cps->empty() && cps->back().end == cp) {
+        cps->back().end = end;
+      } else {
+        cps->push_back({cp, end});
+      }
+    }
+    cp = end;
+  }
+}
+
+// Sorts the byte ranges of the pieces by stream offset and merges the ones
+// that overlap or touch, so every stretch of the stream is fetched once. Each
+// piece is tagged with the range covering it.
+static void plan_piece_reads(std::vector<piece_read_t> *pieces,
+                             std::vector<read_range_t> *ranges) {
+  std::vector<size_t> order(pieces->size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [pieces](size_t a, size_t b) {
+    return (*pieces)[a].offset < (*pieces)[b].offset;
+  });
+
+  ranges->clear();
+  for (size_t i : order) {
+    auto &piece = (*pieces)[i];
+    if (!ranges->empty() &&
+        piece.offset <= ranges->back().offset + ranges->back().len) {
+      auto &r = ranges->back();
+      r.len = std::max(r.len, piece.offset + piece.len - r.offset);
+    } else {
+      ranges->push_back({piece.offset, piece.len, nullptr});
+    }
+    piece.range = ranges->size() - 1;
+  }
+}
+
+// =============================================================================
+
 const uint16_t MsDOC::_fib_base_wIdent = 0xA5EC;
+const size_t MsDOC::_fib_rg_lw97_offset = 0x40;
 const size_t MsDOC::_fib_rg_fc_lcb97_offset = 0x9A;
 
 int MsDOC::ParseFromFile(const std::string &filename) {
-  std::vector<char> data;
-  utils::read_file(filename.c_str(), &data);
-  if (data.size() < sizeof(compound_doc_header_t)) {
+  if (m_comp_doc.ParseFromFile(filename) != 0) {
     return -1;
   }
-  return ParseFromBytes(std::move<>(data));
+  return parse();
 }
 
 int MsDOC::parse() {
-  m_idx_tab0 = -1;
-  m_idx_tab1 = -1;
-  m_idx_word_doc = -1;
-
-  int len_tab0 = -1;
-  int len_tab1 = -1;
-  int len_word_doc = -1;
-
-  auto &dirs = m_comp_doc.GetDirEntries();
-  for (int i = 0; i < static_cast<int>(dirs.size()); ++i) {
-    if (dirs[i].type == kDirEntryTypeEmpty) {
-      continue;
-    }
-    std::string dirname;
-    if (Utf16ToUtf8(dirs[i].unicode_name,
-                    dirs[i].unicode_name + dirs[i].name_len / 2 - 1,
-                    &dirname) != 0) {
-      continue;
-    }
-    if (dirname == g_0TableDirName && len_tab0 < dirs[i].size_of_x) {
-      m_idx_tab0 = i;
-      len_tab0 = dirs[i].size_of_x;
-    } else if (dirname == g_1TableDirName && len_tab1 < dirs[i].size_of_x) {
-      m_idx_tab1 = i;
-      len_tab1 = dirs[i].size_of_x;
-    } else if (dirname == g_WordDocDirName &&
-               len_word_doc < dirs[i].size_of_x) {
-      m_idx_word_doc = i;
-      len_word_doc = dirs[i].size_of_x;
-    }
-  }
+  m_idx_tab0 = m_comp_doc.FindDirEntry(g_0TableDirName);
+  m_idx_tab1 = m_comp_doc.FindDirEntry(g_1TableDirName);
+  m_idx_word_doc = m_comp_doc.FindDirEntry(g_WordDocDirName);
   if (m_idx_word_doc == -1 || (m_idx_tab0 == -1 && m_idx_tab1 == -1)) {
     return -1;
   }
@@ -128,74 +178,118 @@ int MsDOC::FetchText(const fetch_text_options_t *opts,
                      std::string *text) const {
   auto &dirs = m_comp_doc.GetDirEntries();
 
-  std::vector<char> word_doc_stream;
-  if (m_comp_doc.GetDirEntryStream(dirs[m_idx_word_doc], &word_doc_stream) !=
-          0 ||
-      word_doc_stream.size() < sizeof(fib_base_t)) {
+  const size_t fib_len = _fib_rg_fc_lcb97_offset + sizeof(FibRgFcLcb97_t);
+  StreamView fib_stream;
+  std::vector<char> fib_buf;
+  const char *fib;
+  if (m_comp_doc.GetDirEntryStreamView(dirs[m_idx_word_doc], fib_len,
+                                       &fib_stream) != 0 ||
+      fib_stream.Fetch(0, fib_len, &fib_buf, &fib) != 0) {
     return -1;
   }
 
-  auto fib_base = reinterpret_cast<fib_base_t *>(word_doc_stream.data());
+  auto fib_base = reinterpret_cast<const fib_base_t *>(fib);
   if (fib_base->wIdent != _fib_base_wIdent || fib_base->fEncrypted()) {
     return -1;
   }
 
-  if (word_doc_stream.size() < _fib_rg_fc_lcb97_offset ||
-      word_doc_stream.size() - _fib_rg_fc_lcb97_offset <
-          sizeof(FibRgFcLcb97_t)) {
-    return -1;
-  }
-
-  auto fib_rg_fc_lcb97 = reinterpret_cast<FibRgFcLcb97_t *>(
-      word_doc_stream.data() + _fib_rg_fc_lcb97_offset);
+  auto fib_rg_lw97 =
+      reinterpret_cast<const FibRgLw97_t *>(fib + _fib_rg_lw97_offset);
+  auto fib_rg_fc_lcb97 =
+      reinterpret_cast<const FibRgFcLcb97_t *>(fib + _fib_rg_fc_lcb97_offset);
 
-  std::vector<char> table_stream;
-  if (m_comp_doc.GetDirEntryStream(
+  StreamView table_stream;
+  std::vector<char> clx_buf;
+  const char *clx;
+  if (m_comp_doc.GetDirEntryStreamView(
           dirs[fib_base->fWhichTblStm() == 0 ? m_idx_tab0 : m_idx_tab1],
-          &table_stream) != 0) {
+          static_cast<uint64_t>(fib_rg_fc_lcb97->fcClx) +
+              fib_rg_fc_lcb97->lcbClx,
+          &table_stream) != 0 ||
+      table_stream.Fetch(fib_rg_fc_lcb97->fcClx, fib_rg_fc_lcb97->lcbClx,
+                         &clx_buf, &clx) != 0) {
     return -1;
   }
 
   PlcPcd plc_pcd;
-  if (plc_pcd.ParseFrom(*fib_rg_fc_lcb97, table_stream) != 0) {
+  if (plc_pcd.ParseFrom(clx, fib_rg_fc_lcb97->lcbClx) != 0) {
     return -1;
   }
 
-  size_t max_fetch_text_len =
-      opts != nullptr ? opts->max_fetch_text_len
-                      : __defaultFetchTextOptions.max_fetch_text_len;
+  if (opts == nullptr) {
+    opts = &__defaultFetchTextOptions;
+  }
+  std::vector<cp_range_t> cps;
+  select_subdoc_cps(*fib_rg_lw97, opts->doc_subdocs, &cps);
+
+  // Only the parts of pieces that lie in a selected subdocument and fit in
+  // the budget are read, in stream order; the text is then put together in
+  // CP order.
+  size_t max_fetch_text_len = opts->max_fetch_text_len;
   auto &cp_list = plc_pcd.GetCP();
   auto &pcd_list = plc_pcd.GetPcd();
-  for (size_t i = 0; i < pcd_list.size() && max_fetch_text_len > 0; ++i) {
-    size_t offset;
-    size_t len = cp_list[i + 1] - cp_list[i];
-    if (len > max_fetch_text_len) {
-      len = max_fetch_text_len;
+  std::vector<piece_read_t> pieces;
+  size_t stream_len = 0;
+  size_t r = 0;
+  for (size_t i = 0;
+       i < pcd_list.size() && max_fetch_text_len > 0 && r < cps.size(); ++i) {
+    if (cp_list[i + 1] < cp_list[i]) {
+      return -1;
     }
-    if (pcd_list[i].fc.fCompressed() == 1) {  // ANSI
-      offset = pcd_list[i].fc.fc() / 2;
-      if (word_doc_stream.size() < offset ||
-          word_doc_stream.size() - offset < len) {
-        return -1;
-      }
-      text->append(word_doc_stream.data() + offset, len);
-    } else {  // Unicode
-      offset = pcd_list[i].fc.fc();
-      if (word_doc_stream.size() < offset ||
-          word_doc_stream.size() - offset < len * 2) {
-        return -1;
+    while (r < cps.size() && cps[r].end <= cp_list[i]) {
+      ++r;
+    }
+
+    for (size_t k = r; k < cps.size() && cps[k].begin < cp_list[i + 1] &&
+                       max_fetch_text_len > 0;
+         ++k) {
+      int64_t begin = std::max<int64_t>(cp_list[i], cps[k].begin);
+      int64_t end = std::min<int64_t>(cp_list[i + 1], cps[k].end);
+      size_t skip = begin - cp_list[i];
+      size_t len = end - begin;
+      if (len > max_fetch_text_len) {
+        len = max_fetch_text_len;
       }
-      auto ptr = reinterpret_cast<char16_t *>(word_doc_stream.data() + offset);
 
-      std::string s;
-      if (Utf16ToUtf8(ptr, ptr + len, &s) != 0) {
-        return -1;
-      } else {
-        text->append(std::move(s));
+      if (pcd_list[i].fc.fCompressed() == 1) {  // ANSI
+        pieces.push_back({pcd_list[i].fc.fc() / 2 + skip, len, len, true, 0});
+      } else {  // Unicode
+        pieces.push_back(
+            {pcd_list[i].fc.fc() + skip * 2, len * 2, len, false, 0});
       }
+      stream_len =
+          std::max(stream_len, pieces.back().offset + pieces.back().len);
+
+      max_fetch_text_len -= len;
     }
+  }
+
+  std::vector<read_range_t> ranges;
+  plan_piece_reads(&pieces, &ranges);
+
+  StreamView word_doc_stream;
+  if (m_comp_doc.GetDirEntryStreamView(dirs[m_idx_word_doc], stream_len,
+                                       &word_doc_stream) != 0) {
+    return -1;
+  }
 
-    max_fetch_text_len -= len;
+  std::vector<std::vector<char>> bufs(ranges.size());
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    if (word_doc_stream.Fetch(ranges[i].offset, ranges[i].len, &bufs[i],
+                              &ranges[i].p) != 0) {
+      return -1;
+    }
+  }
+
+  for (auto &piece : pieces) {
+    auto &r = ranges[piece.range];
+    const char *p = r.p + (piece.offset - r.offset);
+    if (piece.compressed) {
+      text->append(p, piece.cch);
+    } else {
+      auto ptr = reinterpret_cast<const char16_t *>(p);
+      AppendUtf16ToUtf8(ptr, ptr + piece.cch, text);
+    }
   }
 
   RemoveControlCharacter(text);
@@ -79,6 +79,31 @@ struct fib_base_t {
 #undef _nth_bit
 } __attribute__((packed));
 
+struct FibRgLw97_t {
+  uint32_t cbMac;
+  uint32_t reserved1;
+  uint32_t reserved2;
+  uint32_t ccpText;
+  uint32_t ccpFtn;
+  uint32_t ccpHdd;
+  uint32_t reserved3;
+  uint32_t ccpAtn;
+  uint32_t ccpEdn;
+  uint32_t ccpTxbx;
+  uint32_t ccpHdrTxbx;
+  uint32_t reserved4;
+  uint32_t reserved5;
+  uint32_t reserved6;
+  uint32_t reserved7;
+  uint32_t reserved8;
+  uint32_t reserved9;
+  uint32_t reserved10;
+  uint32_t reserved11;
+  uint32_t reserved12;
+  uint32_t reserved13;
+  uint32_t reserved14;
+} __attribute__((packed));
+
 struct FibRgFcLcb97_t {
   uint32_t fcStshfOrig;
   uint32_t lcbStshfOrig;
@@ -319,8 +344,7 @@ struct Pcd_t {
 
 class PlcPcd {
  public:
-  int ParseFrom(const FibRgFcLcb97_t& fib_rg_fc_lcb97,
-                const std::vector<char>& table_stream);
+  int ParseFrom(const char* clx, size_t clx_len);
 
   inline const std::vector<int32_t>& GetCP() const {
     return m_cp;
@@ -347,6 +371,13 @@ class MsDOC {
     return parse();
   }
 
+  int ParseFromSpan(std::span<const char> data) {
+    if (m_comp_doc.ParseFromSpan(data) != 0) {
+      return -1;
+    }
+    return parse();
+  }
+
   template <typename _T, typename std::enable_if<
                              is_compound_document<_T>::value>::type* = nullptr>
   int ParseFromCompoundDocument(_T&& d) {
@@ -358,6 +389,7 @@ class MsDOC {
 
  private:
   static const uint16_t _fib_base_wIdent;
+  static const size_t _fib_rg_lw97_offset;
   static const size_t _fib_rg_fc_lcb97_offset;
 
   int parse();
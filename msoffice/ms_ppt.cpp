@@ -24,8 +24,9 @@ namespace msoffice {
 
 namespace ppt {
 
-static std::string g_PowerPointDocDirName = "PowerPoint Document";
-static std::string g_CurrentUserDirName = "Current User";
+static const std::u16string_view g_PowerPointDocDirName =
+    u"PowerPoint Document";
+static const std::u16string_view g_CurrentUserDirName = u"Current User";
 
 ssize_t CurrentUserAtom::ReadAndParse(const char *data, size_t size) {
   if (size < sizeof(hdr_t)) {
@@ -151,11 +152,7 @@ static int fetch_text_TextCharsAtom(const char *container_data,
   auto begin = reinterpret_cast<const char16_t *>(container_data);
   auto end = reinterpret_cast<const char16_t *>(container_data + len * 2);
 
-  std::string s;
-  if (Utf16ToUtf8(begin, end, &s) != 0) {
-    return -1;
-  }
-  text->append(std::move(s));
+  AppendUtf16ToUtf8(begin, end, text);
   opts.max_fetch_text_len -= len;
   return 0;
 }
@@ -211,36 +208,15 @@ static int atom_list_fetch_text(const char *container_data,
 // =============================================================================
 
 int MsPPT::ParseFromFile(const std::string &filename) {
-  std::vector<char> data;
-  utils::read_file(filename.c_str(), &data);
-  if (data.size() < sizeof(compound_doc_header_t)) {
+  if (m_comp_doc.ParseFromFile(filename) != 0) {
     return -1;
   }
-  return ParseFromBytes(std::move<>(data));
+  return parse();
 }
 
 int MsPPT::parse() {
-  int32_t idx_current_user = -1;
-  int32_t idx_ppt_doc = -1;
-
-  auto &dirs = m_comp_doc.GetDirEntries();
-  for (int i = 0; i < static_cast<int>(dirs.size()); ++i) {
-    if (dirs[i].type == kDirEntryTypeEmpty) {
-      continue;
-    }
-    std::string dirname;
-    if (Utf16ToUtf8(dirs[i].unicode_name,
-                    dirs[i].unicode_name + dirs[i].name_len / 2 - 1,
-                    &dirname) != 0) {
-      continue;
-    }
-
-    if (dirname == g_CurrentUserDirName) {
-      idx_current_user = i;
-    } else if (dirname == g_PowerPointDocDirName) {
-      idx_ppt_doc = i;
-    }
-  }
+  int32_t idx_current_user = m_comp_doc.FindDirEntry(g_CurrentUserDirName);
+  int32_t idx_ppt_doc = m_comp_doc.FindDirEntry(g_PowerPointDocDirName);
   if (idx_ppt_doc == -1 || idx_current_user == -1) {
     return -1;
   }
@@ -251,14 +227,14 @@ int MsPPT::parse() {
 }
 
 int MsPPT::GetPersistId2Offset(const CurrentUserAtom &current_user_atom,
-                               const char *ppt_doc_stream,
-                               size_t ppt_doc_stream_len,
+                               const StreamView &ppt_doc_stream,
                                std::map<uint32_t, uint32_t> *id2offset) {
-  const char *end = ppt_doc_stream + ppt_doc_stream_len;
+  std::vector<char> atom_buf;
+  std::vector<char> dir_buf;
   const char *p;
   for (size_t offset = current_user_atom.Header().offsetToCurrentEdit;;) {
-    p = ppt_doc_stream + offset;
-    if (p >= end || p + sizeof(UserEditAtom_t) > end) {
+    if (ppt_doc_stream.Fetch(offset, sizeof(UserEditAtom_t), &atom_buf, &p) !=
+        0) {
       return -1;
     }
     auto user_edit_atom = reinterpret_cast<const UserEditAtom_t *>(p);
@@ -273,21 +249,24 @@ int MsPPT::GetPersistId2Offset(const CurrentUserAtom &current_user_atom,
       return -1;
     }
 
-    p = ppt_doc_stream + user_edit_atom->offsetPersistDirectory;
-    if (p >= end || p + sizeof(record_header_t) > end) {
+    record_header_t rh;
+    size_t dir_offset = user_edit_atom->offsetPersistDirectory;
+    if (ppt_doc_stream.Read(dir_offset, sizeof(record_header_t),
+                            reinterpret_cast<char *>(&rh)) != 0) {
       return -1;
     }
-    auto rh = reinterpret_cast<const record_header_t *>(p);
-    if (rh->recVer() != 0 || rh->recInstance() != 0 ||
-        rh->recType != kRT_PersistDirectoryAtom ||
-        p + sizeof(record_header_t) + rh->recLen > end) {
+    if (rh.recVer() != 0 || rh.recInstance() != 0 ||
+        rh.recType != kRT_PersistDirectoryAtom) {
       return -1;
     }
 
-    p += sizeof(record_header_t);
+    if (ppt_doc_stream.Fetch(dir_offset + sizeof(record_header_t), rh.recLen,
+                             &dir_buf, &p) != 0) {
+      return -1;
+    }
     std::vector<const PersistDirectoryEntry_t *> entries;
     if (PersistDirectoryAtom::ParsePersistDirectoryEntry(
-            *user_edit_atom, p, rh->recLen, &entries) != 0) {
+            *user_edit_atom, p, rh.recLen, &entries) != 0) {
       return -1;
     }
 
@@ -337,40 +316,42 @@ int MsPPT::FetchText(const fetch_text_options_t *user_opts,
     return -1;
   }
 
-  std::vector<char> ppt_doc_stream;
-  if (m_comp_doc.GetDirEntryStream(dirs[m_idx_ppt_doc], &ppt_doc_stream) != 0) {
+  StreamView ppt_doc_stream;
+  if (m_comp_doc.GetDirEntryStreamView(dirs[m_idx_ppt_doc], &ppt_doc_stream) !=
+      0) {
     return -1;
   }
 
   std::map<uint32_t, uint32_t> id2offset;
-  if (GetPersistId2Offset(current_user_atom, ppt_doc_stream.data(),
-                          ppt_doc_stream.size(), &id2offset) != 0) {
+  if (GetPersistId2Offset(current_user_atom, ppt_doc_stream, &id2offset) !=
+      0) {
     return -1;
   }
 
-  const char *end = ppt_doc_stream.data() + ppt_doc_stream.size();
+  std::vector<char> buf;
   for (auto i : id2offset) {
-    const char *p = ppt_doc_stream.data() + i.second;
-    if (p >= end || p + sizeof(record_header_t) > end) {
+    record_header_t rh;
+    if (ppt_doc_stream.Read(i.second, sizeof(record_header_t),
+                            reinterpret_cast<char *>(&rh)) != 0) {
       return -1;
     }
-    auto rh = reinterpret_cast<const record_header_t *>(p);
 
     fetch_text_func_t fetch_text_func = nullptr;
-    if (rh->recType == kRT_Document) {
+    if (rh.recType == kRT_Document) {
       fetch_text_func = atom_list_fetch_text;
-    } else if (rh->recType == kRT_Slide) {
+    } else if (rh.recType == kRT_Slide) {
       fetch_text_func = atom_list_fetch_text;
     } else {
       continue;
     }
 
-    p += sizeof(record_header_t);
-    if (p >= end || p + rh->recLen > end) {
+    const char *p;
+    if (ppt_doc_stream.Fetch(i.second + sizeof(record_header_t), rh.recLen,
+                             &buf, &p) != 0) {
       return -1;
     }
 
-    if (fetch_text_func(p, rh->recLen, opts, text) != 0) {
+    if (fetch_text_func(p, rh.recLen, opts, text) != 0) {
       return -1;
     } else if (opts.max_fetch_text_len == 0) {
       break;
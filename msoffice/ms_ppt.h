@@ -349,6 +349,13 @@ class MsPPT {
     return parse();
   }
 
+  int ParseFromSpan(std::span<const char> data) {
+    if (m_comp_doc.ParseFromSpan(data) != 0) {
+      return -1;
+    }
+    return parse();
+  }
+
   template <typename _T, typename std::enable_if<
                              is_compound_document<_T>::value>::type * = nullptr>
   int ParseFromCompoundDocument(_T &&d) {
@@ -357,8 +364,7 @@ class MsPPT {
   }
 
   static int GetPersistId2Offset(const CurrentUserAtom &current_user_atom,
-                                 const char *ppt_doc_stream,
-                                 size_t ppt_doc_stream_len,
+                                 const StreamView &ppt_doc_stream,
                                  std::map<uint32_t, uint32_t> *id2offset);
 
   int FetchText(const fetch_text_options_t *opts, std::string *text) const;
@@ -82,10 +82,9 @@ void RC4Crypt::CopyDWORDs2Bytes(const unsigned int b1, const unsigned int b2,
 void RC4Crypt::Decrypt(char* data, const size_t size,
                        const unsigned long block_index) {
   if (size <= 256) {
-    static unsigned char quick_buf[256];
-    mxDecoder->decode(quick_buf, reinterpret_cast<unsigned char*>(data), size,
+    mxDecoder->decode(m_quick_buf, reinterpret_cast<unsigned char*>(data), size,
                       block_index);
-    memcpy(data, quick_buf, size);
+    memcpy(data, m_quick_buf, size);
   } else {
     std::vector<unsigned char> out_data(size);
     mxDecoder->decode(out_data.data(), reinterpret_cast<unsigned char*>(data),
@@ -97,10 +96,9 @@ void RC4Crypt::Decrypt(char* data, const size_t size,
                        const unsigned long stream_pos,
                        const size_t block_size) {
   if (size <= 256) {
-    static unsigned char quick_buf[256];
-    mxDecoder->decode(quick_buf, reinterpret_cast<unsigned char*>(data), size,
+    mxDecoder->decode(m_quick_buf, reinterpret_cast<unsigned char*>(data), size,
                       stream_pos, block_size);
-    memcpy(data, quick_buf, size);
+    memcpy(data, m_quick_buf, size);
   } else {
     std::vector<unsigned char> out_data(size);
     mxDecoder->decode(out_data.data(), reinterpret_cast<unsigned char*>(data),
@@ -60,6 +60,10 @@ class RC4Crypt : public Crypt {
 
   BiffDecoderRef mxDecoder;
 
+  // Scratch space for short blocks; one decryptor must not be shared between
+  // threads.
+  unsigned char m_quick_buf[256];
+
   bool m_VerifyPassword;
 };
 
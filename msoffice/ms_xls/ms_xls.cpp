@@ -1,12 +1,19 @@
 #include "msoffice/ms_xls/ms_xls.h"
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <limits>
 #include <unordered_map>
 
 #include "msoffice/ms_xls/crypt/Decryptor.h"
 #include "msoffice/utils.h"
+#include "utils/ordered_budget.h"
+#include "utils/thread_pool.h"
 #include "utils/utils.h"
 
 #define _STYLE_Info "\e[3;32m"
@@ -21,7 +28,7 @@ namespace msoffice {
 
 namespace xls {
 
-static const std::string g_WorkbookName = "Workbook";
+static const std::u16string_view g_WorkbookName = u"Workbook";
 static const uint16_t g_BofVersion = 0x0600;
 // static const size_t g_maxRecordSize = 8224;
 
@@ -463,26 +470,26 @@ static int append_rgb_string(const char *data, size_t curr_block_end,
 
   size_t dcnt = 0;
   size_t rsize = curr_block_end - *offset;
-  std::string tmp_str;
   if (highbyte) {  // char16
     size_t block_max_cnt = rsize / 2;
     dcnt = *char_cnt > block_max_cnt ? block_max_cnt : *char_cnt;
     auto begin = reinterpret_cast<const char16_t *>(data + *offset);
-    if (Utf16ToUtf8(begin, begin + dcnt, &tmp_str) != 0) {
-      return -1;
+    if (rgb_str != nullptr) {
+      AppendUtf16ToUtf8(begin, begin + dcnt, rgb_str);
     }
     *offset += dcnt * 2;
-    rgb_str->append(tmp_str);
   } else {
     dcnt = *char_cnt > rsize ? rsize : *char_cnt;
-    tmp_str.assign(data + *offset, dcnt);
-    *offset += dcnt;
-    for (auto &ch : tmp_str) {
-      if (ch < 0) {
-        ch = ' ';
+    if (rgb_str != nullptr) {
+      std::string tmp_str(data + *offset, dcnt);
+      for (auto &ch : tmp_str) {
+        if (ch < 0) {
+          ch = ' ';
+        }
       }
+      rgb_str->append(tmp_str);
     }
-    rgb_str->append(tmp_str);
+    *offset += dcnt;
   }
   *char_cnt -= dcnt;
   return 0;
@@ -521,8 +528,8 @@ static int append_rgb_string_with_continue(const char *data, size_t data_len,
 }
 
 ssize_t FetchTextFromSST(const record_header_t &rh, const char *data,
-                         size_t data_len, size_t offset, int max_sst_cnt,
-                         std::vector<XLUnicodeRichExtendedString> *sst) {
+                         size_t data_len, size_t offset,
+                         const fetch_text_options_t &opts, SharedStrings *sst) {
   size_t curr_block_end = offset + rh.size;
   if (curr_block_end > data_len) {
     return -1;
@@ -537,9 +544,24 @@ ssize_t FetchTextFromSST(const record_header_t &rh, const char *data,
   }
   // slog(Debug, "csTotal %d, cstUnique %d", *csTotal, *cstUnique);
 
+  struct str_pos_t {
+    size_t offset;
+    size_t block_end;
+  };
+  std::vector<str_pos_t> pos;
+
+  int max_sst_cnt = opts.xls_max_sst_cnt;
+  if (max_sst_cnt <= 0) {
+    max_sst_cnt = std::numeric_limits<int>::max();
+  }
   int sst_size = std::min(max_sst_cnt, *cstUnique);
-  std::vector<char> tmp_buf;
-  sst->reserve(sst_size);
+  if (opts.lazy_sst) {
+    pos.reserve(sst_size);
+  } else {
+    // The record size is a fair guess for the arena: most strings are short
+    // and stored as 8-bit characters.
+    sst->Reserve(sst_size, rh.size);
+  }
   for (int i = 0; i < sst_size; ++i) {
     if (offset == curr_block_end) {
       auto next_rh = get_ptr_and_move<record_header_t>(data, data_len, &offset);
@@ -550,65 +572,92 @@ ssize_t FetchTextFromSST(const record_header_t &rh, const char *data,
     }
 
     XLUnicodeRichExtendedString s;
-    ssize_t ofs = s.ReadAndParse(data, data_len, offset, &curr_block_end);
+    ssize_t ofs;
+    if (opts.lazy_sst) {
+      pos.push_back(str_pos_t{offset, curr_block_end});
+      ofs = s.ReadAndParse(data, data_len, offset, &curr_block_end, nullptr);
+    } else {
+      ofs = s.ReadAndParse(data, data_len, offset, &curr_block_end,
+                           sst->Open());
+      sst->Close();
+    }
     if (ofs < 0) {
       return -1;
     }
     offset += ofs;
-    sst->push_back(std::move(s));
+  }
+
+  if (opts.lazy_sst) {
+    size_t n = pos.size();
+    sst->SetLazy(
+        n,
+        [data, data_len, pos = std::move(pos)](size_t idx, std::string *str) {
+          XLUnicodeRichExtendedString s;
+          size_t block_end = pos[idx].block_end;
+          ssize_t ofs = s.ReadAndParse(data, data_len, pos[idx].offset,
+                                       &block_end, str);
+          return ofs < 0 ? -1 : 0;
+        },
+        opts.sst_cache_size);
   }
 
   return max_sst_cnt >= *cstUnique ? offset : curr_block_end;
 }
 
+static bool ends_with_eof(const RecordIndex &index,
+                          const RecordIndex::substream_t &ss) {
+  return ss.end > ss.begin &&
+         index.Records()[ss.end - 1].type == kRecord_EOF;
+}
+
 ssize_t ReadAndParse1stSubstream(
-    const char *data, size_t data_len, int max_sst_cnt,
-    std::vector<BoundSheet8> *bs,
-    std::vector<XLUnicodeRichExtendedString> *sst) {
-  size_t offset = 0;
-  auto bof_rh = get_ptr_and_move<record_header_t>(data, data_len, &offset);
-  if (bof_rh == nullptr || bof_rh->identifier != kRecord_BOF) {
+    const char *data, size_t data_len, const fetch_text_options_t &opts,
+    std::vector<BoundSheet8> *bs, SharedStrings *sst) {
+  RecordIndex index;
+  if (index.Build(StreamView(data, data_len)) != 0 ||
+      !ends_with_eof(index, index.Globals()) ||
+      ParseGlobals(index, data, data_len, opts, bs, sst) != 0) {
     return -1;
   }
+  auto &eof = index.Records()[index.Globals().end - 1];
+  return eof.offset + sizeof(record_header_t) + eof.size;
+}
+
+int ParseGlobals(const RecordIndex &index, const char *data, size_t data_len,
+                 const fetch_text_options_t &opts,
+                 std::vector<BoundSheet8> *bs, SharedStrings *sst) {
+  auto &records = index.Records();
+  auto &globals = index.Globals();
 
+  size_t offset = records[globals.begin].offset + sizeof(record_header_t);
   auto bof = get_ptr_and_move<BOF_t>(data, data_len, &offset);
   if (bof == nullptr || bof->vers != g_BofVersion) {
     return -1;
   }
 
-  for (; offset < data_len;) {
-    auto rh = get_ptr_and_move<record_header_t>(data, data_len, &offset);
-    if (rh == nullptr) {
+  for (uint32_t i = globals.begin + 1; i < globals.end; ++i) {
+    auto &r = records[i];
+    offset = r.offset + sizeof(record_header_t);
+    if (offset + r.size > data_len) {
       return -1;
     }
-    // slog(Info, "%s, size %d", Identifier2Name(rh->identifier).c_str(),
-    //       rh->size);
-
-    if (rh->identifier == kRecord_EOF) {
-      return offset;
-    } else if (rh->identifier == kRecord_SST) {
-      ssize_t ofs =
-          FetchTextFromSST(*rh, data, data_len, offset, max_sst_cnt, sst);
-      if (ofs < 0) {
+    // slog(Info, "%s, size %d", Identifier2Name(r.type).c_str(), r.size);
+
+    if (r.type == kRecord_SST) {
+      // Its Continue records are left to the loop, which skips them.
+      record_header_t rh = {r.type, r.size};
+      if (FetchTextFromSST(rh, data, data_len, offset, opts, sst) < 0) {
         return -1;
       }
-      offset = ofs;
-      continue;
-    } else if (rh->identifier == kRecord_BoundSheet8) {
+    } else if (r.type == kRecord_BoundSheet8) {
       BoundSheet8 b;
       if (b.ParseFrom(data + offset, data_len - offset) != 0) {
         return -1;
       }
       bs->push_back(std::move(b));
-      // } else if (rh->identifier == kRecord_FilePass) {
-      //   slog(Err, "file was encrypted");
-      //   return -1;
     }
-
-    offset += rh->size;
   }
-
-  return -1;
+  return 0;
 }
 
 // =============================================================================
@@ -616,7 +665,8 @@ ssize_t ReadAndParse1stSubstream(
 ssize_t XLUnicodeRichExtendedString::ReadAndParse(const char *data,
                                                   size_t data_len,
                                                   size_t offset,
-                                                  size_t *curr_block_end) {
+                                                  size_t *curr_block_end,
+                                                  std::string *str) {
   size_t ofs = offset;
   auto hdr = get_ptr_and_move<hdr_t>(data, *curr_block_end, &ofs);
   if (hdr == nullptr) {
@@ -642,12 +692,12 @@ ssize_t XLUnicodeRichExtendedString::ReadAndParse(const char *data,
   // rgb
   size_t char_cnt = m_hdr.cch;
   if (append_rgb_string(data, *curr_block_end, m_hdr.fHighByte(), &ofs,
-                        &char_cnt, &m_str) != 0) {
+                        &char_cnt, str) != 0) {
     return -1;
   }
   if (char_cnt > 0) {
     if (append_rgb_string_with_continue(data, data_len, char_cnt, &ofs,
-                                        curr_block_end, &m_str) != 0) {
+                                        curr_block_end, str) != 0) {
       return -1;
     }
   }
@@ -677,9 +727,9 @@ ssize_t XLUnicodeRichExtendedString::ReadAndParse(const char *data,
 
 double RkNumber_t::value() const {
   if (fInt() == 1) {
-    uint32_t n = num();
-    auto val = reinterpret_cast<int *>(&n);
-    return fX100() ? *val / 100.0 : *val;
+    // A signed 30-bit integer: shift the sign down with it.
+    int32_t val = static_cast<int32_t>(flags) >> 2;
+    return fX100() ? val / 100.0 : val;
 
   } else {
     uint64_t n = num();
@@ -807,34 +857,85 @@ int BoundSheet8::ParseFrom(const char *data, size_t data_len) {
 
 // =============================================================================
 
-int MsXLS::ParseFromFile(const std::string &filename) {
-  std::vector<char> data;
-  utils::read_file(filename.c_str(), &data);
-  if (data.size() < sizeof(compound_doc_header_t)) {
+int RecordIndex::Build(const StreamView &view) {
+  m_records.clear();
+  m_substreams.clear();
+  m_encrypted = false;
+  if (view.Size() > UINT32_MAX) {
     return -1;
   }
-  return ParseFromBytes(std::move<>(data));
-}
 
-int MsXLS::parse() {
-  m_idx_workbook = -1;
-  auto &dirs = m_comp_doc.GetDirEntries();
-  for (int i = 0; i < static_cast<int>(dirs.size()); ++i) {
-    if (dirs[i].type == kDirEntryTypeEmpty) {
-      continue;
+  // Substreams waiting for their EOF; more than one when a chart substream
+  // is embedded in a sheet.
+  std::vector<size_t> open;
+  for (size_t offset = 0; offset + sizeof(record_header_t) <= view.Size();) {
+    record_header_t rh;
+    if (view.Read(offset, sizeof(record_header_t),
+                  reinterpret_cast<char *>(&rh)) != 0 ||
+        offset + sizeof(record_header_t) + rh.size > view.Size()) {
+      break;
     }
 
-    std::string dirname;
-    if (Utf16ToUtf8(dirs[i].unicode_name,
-                    dirs[i].unicode_name + dirs[i].name_len / 2 - 1,
-                    &dirname) != 0) {
-      continue;
+    uint32_t pos = m_records.size();
+    m_records.push_back(record_t{static_cast<uint32_t>(offset),
+                                 rh.identifier, rh.size});
+    if (rh.identifier == kRecord_BOF) {
+      open.push_back(m_substreams.size());
+      m_substreams.push_back(substream_t{pos, pos + 1});
+    } else if (rh.identifier == kRecord_EOF) {
+      for (size_t i : open) {
+        m_substreams[i].end = pos + 1;
+      }
+      open.clear();
+    } else if (rh.identifier == kRecord_FilePass && m_substreams.size() == 1 &&
+               !open.empty()) {
+      m_encrypted = true;
     }
+    offset += sizeof(record_header_t) + rh.size;
+  }
+  for (size_t i : open) {
+    m_substreams[i].end = m_records.size();
+  }
 
-    if (dirname == g_WorkbookName) {
-      m_idx_workbook = i;
+  if (m_substreams.empty() || m_substreams[0].begin != 0) {
+    return -1;
+  }
+  return 0;
+}
+
+const RecordIndex::substream_t *RecordIndex::FindSubstream(
+    size_t bof_offset) const {
+  auto it = std::lower_bound(
+      m_substreams.begin(), m_substreams.end(), bof_offset,
+      [this](const substream_t &ss, size_t ofs) {
+        return m_records[ss.begin].offset < ofs;
+      });
+  if (it == m_substreams.end() || m_records[it->begin].offset != bof_offset) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+void RecordIndex::Select(const substream_t &ss, uint16_t type,
+                         std::vector<uint32_t> *pos) const {
+  for (uint32_t i = ss.begin; i < ss.end; ++i) {
+    if (m_records[i].type == type) {
+      pos->push_back(i);
     }
   }
+}
+
+// =============================================================================
+
+int MsXLS::ParseFromFile(const std::string &filename) {
+  if (m_comp_doc.ParseFromFile(filename) != 0) {
+    return -1;
+  }
+  return parse();
+}
+
+int MsXLS::parse() {
+  m_idx_workbook = m_comp_doc.FindDirEntry(g_WorkbookName);
   if (m_idx_workbook == -1) {
     return -1;
   }
@@ -853,9 +954,9 @@ int MsXLS::parse() {
   return 0;
 }
 
-static int append_cell(const char *str, size_t str_cch, const char *delimiter,
-                       size_t delimiter_cch, uint16_t cell_row,
-                       uint16_t cell_col, uint16_t *curr_row,
+static int append_cell(std::string_view str, size_t str_cch,
+                       const char *delimiter, size_t delimiter_cch,
+                       uint16_t cell_row, uint16_t cell_col, uint16_t *curr_row,
                        size_t *max_fetch_text_len, std::string *text) {
   if (*max_fetch_text_len == 0) {
     return 1;
@@ -888,7 +989,8 @@ static int append_cell(const char *str, size_t str_cch, const char *delimiter,
   }
 
   if (*max_fetch_text_len < str_cch) {
-    text->append(str, utils::fix_utf8_word_cnt(str, *max_fetch_text_len));
+    text->append(str.data(), utils::fix_utf8_word_cnt(str.data(), str.size(),
+                                                      *max_fetch_text_len));
     *max_fetch_text_len = 0;
     return 1;
   } else {
@@ -899,189 +1001,271 @@ static int append_cell(const char *str, size_t str_cch, const char *delimiter,
   return *max_fetch_text_len == 0 ? 1 : 0;
 }
 
-static void to_string(double f, std::vector<char> *buf) {
-  if (f > 10) {
-    snprintf(buf->data(), buf->size(), "%.2f", f);
+// Fixed notation of the largest double with the maximum precision fits.
+static constexpr size_t kNumBufLen = 400;
+
+// Writes v to buf and returns its length; the text is plain ASCII, so the
+// length is also its character count.
+static size_t format_number(double v, int legacy_precision,
+                            const fetch_text_options_t &opts, char *buf) {
+  std::to_chars_result r;
+  if (opts.xls_num_format == kXlsNumShortest) {
+    r = std::to_chars(buf, buf + kNumBufLen, v);
+  } else if (opts.xls_num_format == kXlsNumFixed) {
+    r = std::to_chars(buf, buf + kNumBufLen, v, std::chars_format::fixed,
+                      std::clamp(opts.xls_num_precision, 0, 20));
   } else {
-    snprintf(buf->data(), buf->size(), "%f", f);
+    r = std::to_chars(buf, buf + kNumBufLen, v, std::chars_format::fixed,
+                      legacy_precision);
   }
+  return r.ec == std::errc() ? r.ptr - buf : 0;
 }
 
-static void to_string(const RkNumber_t &rk, std::vector<char> *buf) {
-  snprintf(buf->data(), buf->size(), "%.2f", rk.value());
+static inline size_t format_number(double f, const fetch_text_options_t &opts,
+                                   char *buf) {
+  return format_number(f, f > 10 ? 2 : 6, opts, buf);
 }
 
-int MsXLS::FetchText(const fetch_text_options_t *user_opts,
-                     std::string *text) const {
-  fetch_text_options_t opts =
-      user_opts != nullptr ? *user_opts : __defaultFetchTextOptions;
-  size_t delimiter_cch = utils::count_utf8_word_cnt(opts.xls_delimiter);
+static inline size_t format_number(const RkNumber_t &rk,
+                                   const fetch_text_options_t &opts,
+                                   char *buf) {
+  return format_number(rk.value(), 2, opts, buf);
+}
 
-  std::vector<char> workbook_stream;
-  if (m_comp_doc.GetDirEntryStream(m_comp_doc.GetDirEntries()[m_idx_workbook],
-                                   &workbook_stream) != 0) {
-    return -1;
+// Name of one sheet and the text of its cells.
+static int fetch_sheet_text(const StreamView &stream, const RecordIndex &index,
+                            const BoundSheet8 &bs, const SharedStrings &sst,
+                            const fetch_text_options_t &opts,
+                            size_t delimiter_cch, size_t *max_len,
+                            std::string *text) {
+  auto &records = index.Records();
+  if (*max_len < bs.Name().Cch()) {
+    auto &name = bs.Name().String();
+    text->append(name.c_str(),
+                 utils::fix_utf8_word_cnt(name.c_str(), *max_len));
+    *max_len = 0;
+  } else {
+    text->append(bs.Name().String().c_str());
+    *max_len -= bs.Name().Cch();
   }
-  if (Decrypt(workbook_stream.data(), workbook_stream.size()) != 0) {
-    return -1;
+  if (*max_len == 0) {
+    return 0;
   }
 
-  const char *data = workbook_stream.data();
-  size_t data_len = workbook_stream.size();
+  text->push_back('\n');
+  *max_len -= 1;
+  if (*max_len == 0) {
+    return 0;
+  }
 
-  std::vector<BoundSheet8> bs_list;
-  std::vector<XLUnicodeRichExtendedString> sst;
-  if (ReadAndParse1stSubstream(data, data_len, opts.xls_max_sst_cnt, &bs_list,
-                               &sst) < 0) {
+  auto sheet = index.FindSubstream(bs.LbPlyPos());
+  if (sheet == nullptr || records[sheet->begin].size < sizeof(BOF_t)) {
     return -1;
   }
 
-  // const char *data = m_workbook_stream.data();
-  // size_t data_len = m_workbook_stream.size();
-  // auto &bs_list = m_bs_list;
-  // auto &sst = m_sst;
-
-  for (auto &bs : bs_list) {
-    if (bs.Dt() != BoundSheet8::kDT_WorksheetOrDialogSheet ||
-        bs.HsState() != 0x00) {
-      continue;
+#define _get_ptr(_ptr, _type)                                   \
+  if (rh.size < sizeof(_type)) {                                \
+    return -1;                                                  \
+  }                                                             \
+  auto _ptr = reinterpret_cast<const _type *>(data);
+
+  bool eof = false;
+  uint16_t row = 0;
+  char num_buf[kNumBufLen];
+  size_t num_len;
+  std::string sst_buf;
+  std::vector<char> buf;
+  for (uint32_t i = sheet->begin + 1; i < sheet->end && *max_len > 0; ++i) {
+    record_header_t rh = {records[i].type, records[i].size};
+    const char *data;
+    if (stream.Fetch(records[i].offset + sizeof(record_header_t), rh.size,
+                     &buf, &data) != 0) {
+      return -1;
     }
 
-    if (opts.max_fetch_text_len < bs.Name().Cch()) {
-      auto &name = bs.Name().String();
-      text->append(name.c_str(), utils::fix_utf8_word_cnt(
-                                     name.c_str(), opts.max_fetch_text_len));
-      opts.max_fetch_text_len = 0;
-    } else {
-      text->append(bs.Name().String().c_str());
-      opts.max_fetch_text_len -= bs.Name().Cch();
-    }
-    if (opts.max_fetch_text_len == 0) {
+    if (rh.identifier == kRecord_EOF) {
+      text->push_back('\n');
+      *max_len -= 1;
+      eof = true;
       break;
+    } else if (rh.identifier == kRecord_LabelSst) {
+      _get_ptr(lab, LabelSst_t);
+      std::string_view sst_txt;
+      size_t sst_txt_cch;
+      if (sst.Lookup(lab->isst, &sst_buf, &sst_txt, &sst_txt_cch) != 0) {
+        sst_txt = "_";
+        sst_txt_cch = 1;
+      }
+      append_cell(sst_txt, sst_txt_cch, opts.xls_delimiter.c_str(),
+                  delimiter_cch, lab->cell.rw, lab->cell.col, &row, max_len,
+                  text);
+
+    } else if (rh.identifier == kRecord_RK) {
+      _get_ptr(rk, RK_t);
+      num_len = format_number(rk->rkrec.RK, opts, num_buf);
+      append_cell(std::string_view(num_buf, num_len), num_len,
+                  opts.xls_delimiter.c_str(), delimiter_cch, rk->rw, rk->col,
+                  &row, max_len, text);
+
+    } else if (rh.identifier == kRecord_MulRk) {
+      MulRk mrk;
+      if (mrk.ParseFrom(data, rh.size) != 0) {
+        return -1;
+      }
+      uint16_t cell_col = mrk.ColFirst();
+      for (auto &rk : mrk.RgRkrec()) {
+        num_len = format_number(rk.RK, opts, num_buf);
+        append_cell(std::string_view(num_buf, num_len), num_len,
+                    opts.xls_delimiter.c_str(), delimiter_cch, mrk.Rw(),
+                    cell_col++, &row, max_len, text);
+      }
+    } else if (rh.identifier == kRecord_Number) {
+      _get_ptr(n, Number_t);
+      num_len = format_number(n->num, opts, num_buf);
+      append_cell(std::string_view(num_buf, num_len), num_len,
+                  opts.xls_delimiter.c_str(), delimiter_cch, n->cell.rw,
+                  n->cell.col, &row, max_len, text);
+    } else if (rh.identifier == kRecord_Blank && !opts.xls_skip_blank_cell) {
+      _get_ptr(bk, Blank_t);
+      append_cell(" ", 1, opts.xls_delimiter.c_str(), delimiter_cch,
+                  bk->cell.rw, bk->cell.col, &row, max_len, text);
+    } else if (rh.identifier == kRecord_MulBlank &&
+               !opts.xls_skip_blank_cell) {
+      MulBlank mbk;
+      if (mbk.ParseFrom(data, rh.size) != 0) {
+        return -1;
+      }
+      for (uint16_t cell_col = mbk.ColFirst(); cell_col < mbk.ColLast();
+           ++cell_col) {
+        append_cell(" ", 1, opts.xls_delimiter.c_str(), delimiter_cch,
+                    mbk.Rw(), cell_col, &row, max_len, text);
+      }
     }
+  }
+  if (!eof && *max_len != 0) {
+    return -1;
+  }
+  return 0;
 
-    text->push_back('\n');
-    opts.max_fetch_text_len -= 1;
-    if (opts.max_fetch_text_len == 0) {
-      break;
-    }
+#undef _get_ptr
+}
+
+int MsXLS::FetchRecordIndex(StreamView *stream, RecordIndex *index) const {
+  if (m_comp_doc.GetDirEntryStreamView(
+          m_comp_doc.GetDirEntries()[m_idx_workbook], stream) != 0) {
+    return -1;
+  }
+  return index->Build(*stream);
+}
+
+int MsXLS::FetchText(const fetch_text_options_t *user_opts,
+                     std::string *text) const {
+  const fetch_text_options_t &opts =
+      user_opts != nullptr ? *user_opts : __defaultFetchTextOptions;
+  size_t delimiter_cch = utils::count_utf8_word_cnt(opts.xls_delimiter);
 
-    size_t offset = bs.LbPlyPos();
-    if (offset > data_len || offset + sizeof(record_header_t) > data_len) {
+  // The stream is walked once; globals, decryption and every sheet work off
+  // the record table.
+  StreamView workbook_stream;
+  RecordIndex index;
+  if (FetchRecordIndex(&workbook_stream, &index) != 0 ||
+      !ends_with_eof(index, index.Globals())) {
+    return -1;
+  }
+  auto &records = index.Records();
+  auto &globals_eof = records[index.Globals().end - 1];
+  size_t globals_len =
+      globals_eof.offset + sizeof(record_header_t) + globals_eof.size;
+
+  // Record data is encrypted with its position in the whole stream, so an
+  // encrypted workbook is still decrypted in one piece.
+  std::vector<char> decrypted_stream;
+  if (index.Encrypted()) {
+    if (workbook_stream.ReadAll(&decrypted_stream) != 0 ||
+        Decrypt(index, decrypted_stream.data(), decrypted_stream.size()) !=
+            0) {
       return -1;
     }
+    workbook_stream =
+        StreamView(decrypted_stream.data(), decrypted_stream.size());
+  }
 
-#define _get_ptr(_ptr, _type)                                   \
-  auto _ptr = get_ptr_and_move<_type>(data, data_len, &offset); \
-  if (_ptr == nullptr) {                                        \
-    return -1;                                                  \
+  std::vector<char> globals_buf;
+  const char *globals;
+  if (workbook_stream.Fetch(0, globals_len, &globals_buf, &globals) != 0) {
+    return -1;
   }
 
-    _get_ptr(bof_rh, record_header_t);
-    if (bof_rh->identifier != kRecord_BOF) {
-      return -1;
+  std::vector<BoundSheet8> bs_list;
+  SharedStrings sst;
+  if (ParseGlobals(index, globals, globals_len, opts, &bs_list, &sst) != 0) {
+    return -1;
+  }
+
+  std::vector<const BoundSheet8 *> sheets;
+  for (auto &bs : bs_list) {
+    if (bs.Dt() == BoundSheet8::kDT_WorksheetOrDialogSheet &&
+        bs.HsState() == 0x00) {
+      sheets.push_back(&bs);
     }
+  }
 
-    _get_ptr(bof, BOF_t);
-    bool eof = false;
-    uint16_t row = 0;
-    std::vector<char> buf(64);
-    for (; offset < data_len && opts.max_fetch_text_len > 0;) {
-      _get_ptr(rh, record_header_t);
-
-      if (rh->identifier == kRecord_EOF) {
-        text->push_back('\n');
-        opts.max_fetch_text_len -= 1;
-        eof = true;
-        break;
-      } else if (rh->identifier == kRecord_LabelSst) {
-        _get_ptr(lab, LabelSst_t);
-        const char *sst_txt = "_";
-        uint16_t sst_txt_cch = 1;
-        if (lab->isst < sst.size()) {
-          sst_txt = sst[lab->isst].String().c_str();
-          sst_txt_cch = sst[lab->isst].Hdr().cch;
-        }
-        append_cell(sst_txt, sst_txt_cch, opts.xls_delimiter.c_str(),
-                    delimiter_cch, lab->cell.rw, lab->cell.col, &row,
-                    &opts.max_fetch_text_len, text);
-
-      } else if (rh->identifier == kRecord_RK) {
-        _get_ptr(rk, RK_t);
-        to_string(rk->rkrec.RK, &buf);
-        append_cell(buf.data(), strlen(buf.data()), opts.xls_delimiter.c_str(),
-                    delimiter_cch, rk->rw, rk->col, &row,
-                    &opts.max_fetch_text_len, text);
-
-      } else if (rh->identifier == kRecord_MulRk) {
-        MulRk mrk;
-        if (mrk.ParseFrom(data + offset, rh->size) != 0) {
-          return -1;
-        }
-        uint16_t cell_col = mrk.ColFirst();
-        for (auto &rk : mrk.RgRkrec()) {
-          to_string(rk.RK, &buf);
-          append_cell(buf.data(), strlen(buf.data()),
-                      opts.xls_delimiter.c_str(), delimiter_cch, mrk.Rw(),
-                      cell_col++, &row, &opts.max_fetch_text_len, text);
+  // Sheets are independent once the globals are parsed. Workers only read
+  // the stream and the SST; their text is joined in sheet order, and each
+  // one is capped by what the finished sheets before it left of the budget.
+  std::atomic<bool> failed(false);
+  utils::OrderedBudget budget(opts.max_fetch_text_len, text);
+  utils::ParallelFor(
+      sheets.size(), std::max(opts.part_workers, 1), [&](int, size_t idx) {
+        size_t max_len = budget.Remaining(idx);
+        if (max_len == 0 || failed) {
+          budget.Skip(idx);
+          return;
         }
-        offset += rh->size;
-      } else if (rh->identifier == kRecord_Number) {
-        auto n = reinterpret_cast<const Number_t *>(data + offset);
-        to_string(n->num, &buf);
-        append_cell(buf.data(), strlen(buf.data()), opts.xls_delimiter.c_str(),
-                    delimiter_cch, n->cell.rw, n->cell.col, &row,
-                    &opts.max_fetch_text_len, text);
-        offset += rh->size;
-      } else if (rh->identifier == kRecord_Blank && !opts.xls_skip_blank_cell) {
-        _get_ptr(bk, Blank_t);
-        append_cell(" ", 1, opts.xls_delimiter.c_str(), delimiter_cch,
-                    bk->cell.rw, bk->cell.col, &row, &opts.max_fetch_text_len,
-                    text);
-      } else if (rh->identifier == kRecord_MulBlank &&
-                 !opts.xls_skip_blank_cell) {
-        MulBlank mbk;
-        if (mbk.ParseFrom(data + offset, rh->size) != 0) {
-          return -1;
-        }
-        for (uint16_t cell_col = mbk.ColFirst(); cell_col < mbk.ColLast();
-             ++cell_col) {
-          append_cell(" ", 1, opts.xls_delimiter.c_str(), delimiter_cch,
-                      mbk.Rw(), cell_col, &row, &opts.max_fetch_text_len, text);
+
+        std::string sheet_text;
+        if (fetch_sheet_text(workbook_stream, index, *sheets[idx], sst, opts,
+                             delimiter_cch, &max_len, &sheet_text) != 0) {
+          failed = true;
+          budget.Skip(idx);
+          return;
         }
-        offset += rh->size;
-      } else {
-        offset += rh->size;
-      }
-    }
-    if (!eof && opts.max_fetch_text_len != 0) {
-      return -1;
-    }
+        budget.Commit(idx, std::move(sheet_text));
+      });
+  if (failed) {
+    return -1;
   }
+
   RemoveControlCharacter(text);
   return 0;
-
-#undef _get_ptr
 }
 
 int Decrypt(char *data, size_t data_len, const std::wstring &password) {
+  RecordIndex index;
+  if (index.Build(StreamView(data, data_len)) != 0) {
+    return -1;
+  }
+  return Decrypt(index, data, data_len, password);
+}
+
+int Decrypt(const RecordIndex &index, char *data, size_t data_len,
+            const std::wstring &password) {
   CRYPT::DecryptorPtr decry_ptr = nullptr;
 
-  for (size_t offset = 0; offset < data_len;) {
-    auto rh = reinterpret_cast<const record_header_t *>(data + offset);
-    if (offset + sizeof(record_header_t) > data_len ||
-        offset + sizeof(record_header_t) + rh->size > data_len) {
+  for (auto &r : index.Records()) {
+    size_t offset = r.offset + sizeof(record_header_t);
+    if (offset + r.size > data_len) {
       break;
     }
-    offset += sizeof(msoffice::xls::record_header_t);
+    record_header_t rh = {r.type, r.size};
 
-    if (rh->identifier == kRecord_FilePass) {
+    if (rh.identifier == kRecord_FilePass) {
       decry_ptr = get_decryptor(data + offset, password);
       if (decry_ptr == nullptr) {
         return -1;
       }
     } else if (decry_ptr != nullptr) {
-      switch (rh->identifier) {
+      switch (rh.identifier) {
         case kRecord_BoundSheet8:
         case kRecord_Continue:
         case kRecord_LabelSst:
@@ -1091,13 +1275,12 @@ int Decrypt(char *data, size_t data_len, const std::wstring &password) {
         case kRecord_Blank:
         case kRecord_MulBlank:
         case kRecord_SST:
-          decrypt_record(decry_ptr, *rh, data, offset);
+          decrypt_record(decry_ptr, rh, data, offset);
           break;
         default:
           break;
       }
     }
-    offset += rh->size;
   }
   return 0;
 }
@@ -5,6 +5,7 @@
 
 #include "msoffice/compound_document.h"
 #include "msoffice/ms_xls/crypt/Crypt.h"
+#include "msoffice/shared_strings.h"
 #include "msoffice/utils.h"
 
 namespace msoffice {
@@ -615,19 +616,16 @@ class XLUnicodeRichExtendedString {
 #undef _nth_bit
   } __attribute__((packed));
 
+  // The characters are appended to str as UTF-8.
   ssize_t ReadAndParse(const char *data, size_t data_len, size_t offset,
-                       size_t *curr_block_end);
+                       size_t *curr_block_end, std::string *str);
 
   inline const hdr_t &Hdr() const {
     return m_hdr;
   }
-  inline const std::string &String() const {
-    return m_str;
-  }
 
  private:
   hdr_t m_hdr;
-  std::string m_str;
 };
 
 class BoundSheet8 {
@@ -661,6 +659,54 @@ class BoundSheet8 {
   ShortXLUnicodeString m_name;
 };
 
+// Table of all records of a workbook stream, built in one pass over the
+// record headers. Every BOF opens a substream that runs up to and including
+// the next EOF; the first one is the globals substream. Record headers are
+// never encrypted, so the table also describes an encrypted stream.
+class RecordIndex {
+ public:
+  struct record_t {
+    uint32_t offset;  // of the record header in the stream
+    uint16_t type;
+    uint16_t size;
+  };
+
+  // [begin, end) positions in Records(); begin is the BOF.
+  struct substream_t {
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  int Build(const StreamView &view);
+
+  inline const std::vector<record_t> &Records() const {
+    return m_records;
+  }
+  inline const std::vector<substream_t> &Substreams() const {
+    return m_substreams;
+  }
+  inline const substream_t &Globals() const {
+    return m_substreams[0];
+  }
+  // FilePass in the globals substream.
+  inline bool Encrypted() const {
+    return m_encrypted;
+  }
+
+  // Substream whose BOF header is at `bof_offset`, e.g. BoundSheet8's
+  // lbPlyPos; nullptr if there is none.
+  const substream_t *FindSubstream(size_t bof_offset) const;
+
+  // Appends the positions of the records of `type` in `ss`.
+  void Select(const substream_t &ss, uint16_t type,
+              std::vector<uint32_t> *pos) const;
+
+ private:
+  std::vector<record_t> m_records;
+  std::vector<substream_t> m_substreams;
+  bool m_encrypted = false;
+};
+
 class MsXLS {
  public:
   int ParseFromFile(const std::string &filename);
@@ -674,6 +720,13 @@ class MsXLS {
     return parse();
   }
 
+  int ParseFromSpan(std::span<const char> data) {
+    if (m_comp_doc.ParseFromSpan(data) != 0) {
+      return -1;
+    }
+    return parse();
+  }
+
   template <typename _T, typename std::enable_if<
                              is_compound_document<_T>::value>::type * = nullptr>
   int ParseFromCompoundDocument(_T &&d) {
@@ -683,6 +736,10 @@ class MsXLS {
 
   int FetchText(const fetch_text_options_t *opts, std::string *text) const;
 
+  // Indexes the records of the Workbook stream. Record offsets refer to
+  // `stream`, whose record data is still encrypted if index->Encrypted().
+  int FetchRecordIndex(StreamView *stream, RecordIndex *index) const;
+
  private:
   int parse();
 
@@ -699,17 +756,27 @@ class MsXLS {
 
 const std::string &Identifier2Name(uint16_t identifier);
 
+// With opts.lazy_sst the table decodes its strings from data later on, so
+// data must outlive sst.
 ssize_t FetchTextFromSST(const record_header_t &rh, const char *data,
-                         size_t data_len, size_t offset, int max_sst_cnt,
-                         std::vector<XLUnicodeRichExtendedString> *sst);
+                         size_t data_len, size_t offset,
+                         const fetch_text_options_t &opts, SharedStrings *sst);
 
 ssize_t ReadAndParse1stSubstream(const char *data, size_t data_len,
-                                 int max_sst_cnt,
+                                 const fetch_text_options_t &opts,
                                  std::vector<BoundSheet8> *bs_list,
-                                 std::vector<XLUnicodeRichExtendedString> *sst);
+                                 SharedStrings *sst);
+
+// As above, for the globals substream of an existing index. `data` holds the
+// stream from offset 0 up to at least the end of the globals.
+int ParseGlobals(const RecordIndex &index, const char *data, size_t data_len,
+                 const fetch_text_options_t &opts,
+                 std::vector<BoundSheet8> *bs_list, SharedStrings *sst);
 
 int Decrypt(char *data, size_t data_len,
             const std::wstring &password = L"VelvetSweatshop");
+int Decrypt(const RecordIndex &index, char *data, size_t data_len,
+            const std::wstring &password = L"VelvetSweatshop");
 
 }  // namespace xls
 
@@ -4,9 +4,14 @@
 #include <string.h>
 #include <zip.h>
 
+#include <algorithm>
+#include <charconv>
+#include <functional>
 #include <limits>
 #include <memory>
 
+#include "utils/ordered_budget.h"
+#include "utils/thread_pool.h"
 #include "utils/utils.h"
 
 #define _STYLE_Info "\e[3;32m"
@@ -26,7 +31,8 @@ namespace msoffice {
 
 namespace officex {
 
-ZipHelper::ZipHelper() : m_zsrc(nullptr), m_zfd(nullptr) {}
+ZipHelper::ZipHelper()
+    : m_data(nullptr), m_data_len(0), m_zsrc(nullptr), m_zfd(nullptr) {}
 
 ZipHelper::~ZipHelper() {
   if (m_zfd != nullptr) {
@@ -92,6 +98,8 @@ _ERR_HAS_BUF_CREATE:
   return -1;
 
 _INIT_OK:
+  m_data = data;
+  m_data_len = data_len;
   m_zsrc = zsrc;
   m_zfd = zfd;
   m_name2idx.swap(name2idx);
@@ -136,107 +144,109 @@ int ZipHelper::ReadByName(const std::string &name, size_t max_read_len,
   return zip_read_by_name(m_name2idx, m_zfd, name, max_read_len, data);
 }
 
-// =============================================================================
-
-class _TempTruncateStr {
- public:
-  _TempTruncateStr(const char *p, size_t len)
-      : m_ch(p[len]), m_pos(const_cast<char *>(p) + len) {
-    *m_pos = 0;
-  }
-  ~_TempTruncateStr() {
-    *m_pos = m_ch;
+int ZipHelper::OpenByName(const std::string &name, zip_file_t **zfile,
+                          size_t *size) const {
+  auto it = m_name2idx.find(name);
+  if (it == m_name2idx.end()) {
+    return -1;
   }
 
- private:
-  char m_ch;
-  char *m_pos;
-};
-
-#define _temp_truncate_string(_p_, _len_) \
-  _TempTruncateStr CONCAT(__tmp_truncate_str, __LINE__)(_p_, _len_)
+  zip_stat_t zs;
+  zip_stat_init(&zs);
+  if (zip_stat_index(m_zfd, it->second, 0, &zs) != 0) {
+    return -1;
+  }
 
-static inline bool is_sst_tag(const char *tag, size_t tag_len) {
-  _temp_truncate_string(tag, tag_len);
-  const char *p = strstr(tag, "t=\"s\"");
-  return p != nullptr;
+  *zfile = zip_fopen_index(m_zfd, it->second, 0);
+  if (*zfile == nullptr) {
+    return -1;
+  }
+  *size = zs.size;
+  return 0;
 }
 
-static bool get_attr_value(const char *tag, size_t tag_len, const char *name,
-                           std::string *val) {
-  _temp_truncate_string(tag, tag_len);
-  const char *p = strstr(tag, name);
-  if (p == nullptr) {
-    return false;
-  }
+// =============================================================================
 
-  size_t nlen = strlen(name);
-  const char *quot = p + nlen;
-  if (*quot != '"' && *quot != '\'') {
-    return false;
+ZipXmlReader::ZipXmlReader()
+    : m_zfile(nullptr),
+      m_size(0),
+      m_read(0),
+      m_max_read_len(0),
+      m_window_size(0),
+      m_eof(true),
+      m_overflow(false) {}
+
+ZipXmlReader::~ZipXmlReader() {
+  if (m_zfile != nullptr) {
+    zip_fclose(m_zfile);
   }
+}
 
-  const char *i = quot + 1;
-  for (; i < tag + tag_len && *i != *quot; ++i) {
+int ZipXmlReader::Open(const ZipHelper &zip, const std::string &name,
+                       size_t max_read_len, size_t window_size) {
+  if (m_zfile != nullptr) {
+    zip_fclose(m_zfile);
+    m_zfile = nullptr;
   }
-  if (i == tag + tag_len) {
-    return false;
+  if (zip.OpenByName(name, &m_zfile, &m_size) != 0) {
+    return -1;
   }
 
-  val->assign(quot + 1, i - (quot + 1));
-  return true;
+  m_name = name;
+  m_read = 0;
+  m_max_read_len = std::min(m_size, max_read_len);
+  m_window_size = std::max(window_size, static_cast<size_t>(16));
+  m_eof = false;
+  m_overflow = false;
+  m_buf.clear();
+  m_buf.reserve(m_window_size);
+  m_tz = XmlTokenizer(m_buf.data(), 0, true);
+  return 0;
 }
 
-static bool is_tag(const char *s, const char *name) {
-  size_t nlen = strlen(name);
-  if (strncmp(s, name, nlen) != 0) {
-    return false;
+// Drops what the tokenizer has consumed, keeping the unfinished construct it
+// stopped at, and inflates behind it up to the window size.
+int ZipXmlReader::fill() {
+  m_buf.erase(0, m_tz.Offset());
+  if (m_buf.size() >= m_window_size) {
+    m_overflow = true;
+    return -1;
   }
-  const char *p = s + nlen;
-  if (*p == '\0' || !(*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r' ||
-                      *p == '>' || *p == '/')) {
-    return false;
+
+  size_t old_size = m_buf.size();
+  size_t want = std::min(m_window_size - old_size, m_max_read_len - m_read);
+  m_buf.resize(old_size + want);
+  zip_int64_t n = want == 0 ? 0 : zip_fread(m_zfile, &m_buf[old_size], want);
+  if (n < 0) {
+    m_buf.resize(old_size);
+    return -1;
   }
-  return true;
-}
+  m_buf.resize(old_size + n);
+  m_read += n;
+  m_eof = n == 0 || m_read >= m_max_read_len;
 
-static inline bool is_empty_element_tag(const char *s, size_t len) {
-  return len > 2 && s[len - 2] == '/' && s[len - 1] == '>';
+  m_tz = XmlTokenizer(m_buf.data(), m_buf.size(), !m_eof);
+  return 0;
 }
 
-static bool find_tag(const char *s, const char *name, const char **out,
-                     size_t *out_len) {
-  for (const char *left = s; *left != '\0'; ++left) {
-    left = strstr(left, name);
-    if (left == nullptr) {
-      return false;
-    }
-
-    const char *right = left + strlen(name);
-    if (*right == '\0') {
-      return false;
-    } else if (!(*right == ' ' || *right == '\t' || *right == '\n' ||
-                 *right == '\r' || *right == '>' || *right == '/')) {
-      continue;
-    }
-    if ((right = strchr(right, '>')) == nullptr) {
+bool ZipXmlReader::Next(xml_token_t *tok) {
+  while (!m_tz.Next(tok)) {
+    if (m_eof || !m_tz.NeedMore() || fill() != 0) {
       return false;
     }
-
-    *out = left;
-    *out_len = right - left + 1;
-    return true;
   }
-  return false;
+  return true;
 }
 
+// =============================================================================
+
 static void append_text(std::string *text, size_t *max_len, const char *s,
                         size_t len, size_t wcnt) {
   if (wcnt <= *max_len) {
     text->append(s, len);
     *max_len -= wcnt;
   } else {
-    size_t offset = utils::fix_utf8_word_cnt(s, *max_len);
+    size_t offset = utils::fix_utf8_word_cnt(s, len, *max_len);
     text->append(s, offset);
     *max_len = 0;
   }
@@ -250,31 +260,162 @@ static inline void append_text(std::string *text, size_t *max_len,
 
 // =============================================================================
 
-int MsDOCxFetchText(char *xml_text, const fetch_text_options_t *opts,
-                    std::string *text) {
-  if (opts == nullptr) {
-    opts = &__defaultFetchTextOptions;
+static inline bool is_start(const xml_token_t &tok, std::string_view name) {
+  return tok.type == kXmlTokenStart && tok.name == name;
+}
+
+static inline bool is_end(const xml_token_t &tok, std::string_view name) {
+  return tok.type == kXmlTokenEnd && tok.name == name;
+}
+
+// Spreadsheet parts come both with and without the "x:" prefix.
+static inline bool is_xstart(const xml_token_t &tok, std::string_view name) {
+  return tok.type == kXmlTokenStart && XmlLocalName(tok.name) == name;
+}
+
+static inline bool is_xend(const xml_token_t &tok, std::string_view name) {
+  return tok.type == kXmlTokenEnd && XmlLocalName(tok.name) == name;
+}
+
+static inline void append_newline(std::string *text, size_t *max_len) {
+  if (*max_len > 0) {
+    text->push_back('\n');
+    *max_len -= 1;
   }
-  size_t max_len = opts->max_fetch_text_len;
+}
 
-  const char *ll = nullptr;
-  size_t llen = 0;
-  for (bool f = find_tag(xml_text, "<w:t", &ll, &llen); f && max_len > 0;
-       f = find_tag(ll + llen, "<w:t", &ll, &llen)) {
-    const char *lr = ll + llen;
-    const char *rl = nullptr;
-    size_t rlen = 0;
-    if (!find_tag(lr, "</w:t", &rl, &rlen)) {
+static inline int open_part(ZipXmlReader *reader, const ZipHelper &zip,
+                            const std::string &name,
+                            const fetch_text_options_t *opts) {
+  return reader->Open(zip, name, opts->xml_max_file_len,
+                      opts->xml_window_size);
+}
+
+static inline void report_part(const ZipXmlReader &reader,
+                               const fetch_text_options_t *opts) {
+  if (opts->xml_part_stats != nullptr) {
+    opts->xml_part_stats->push_back(reader.Stat());
+  }
+}
+
+// Reads a .rels part; targets are resolved against `dir` ("xl/", "ppt/").
+static int fetch_relationships(ZipHelper &zip, const std::string &rels_name,
+                               const std::string &dir,
+                               const fetch_text_options_t *opts,
+                               std::map<std::string, std::string> *rid2target) {
+  ZipXmlReader reader;
+  if (open_part(&reader, zip, rels_name, opts) != 0) {
+    return -1;
+  }
+
+  xml_token_t tok;
+  bool found = false;
+  while (reader.Next(&tok)) {
+    if (is_start(tok, "Relationships")) {
+      found = true;
+    } else if (is_end(tok, "Relationships")) {
       break;
+    } else if (found && is_start(tok, "Relationship")) {
+      std::string_view rid;
+      std::string_view target;
+      if (XmlAttrValue(tok.attrs, "Id", &rid) &&
+          XmlAttrValue(tok.attrs, "Target", &target) && !rid.empty() &&
+          !target.empty()) {
+        std::string path = target[0] == '/' ? std::string(target.substr(1))
+                                            : dir + std::string(target);
+        rid2target->insert({std::string(rid), std::move(path)});
+      }
+    }
+  }
+  report_part(reader, opts);
+  return found ? 0 : -1;
+}
+
+typedef std::function<void(ZipHelper &zip, size_t idx, size_t *max_len,
+                           std::string *text, part_stat_t *stat)>
+    part_fetch_fn_t;
+
+// Runs fn for parts [0, n) on opts->part_workers threads and joins their
+// text in index order under the text budget. libzip handles are not
+// thread-safe: worker 0 runs on this thread and uses `zip`, every other
+// worker opens its own over the same buffer.
+static void fetch_parts(ZipHelper &zip, size_t n,
+                        const fetch_text_options_t *opts,
+                        const part_fetch_fn_t &fn, std::string *text) {
+  int workers = std::max(opts->part_workers, 1);
+  std::vector<std::unique_ptr<ZipHelper>> zips(workers);
+  std::vector<part_stat_t> stats(n);
+
+  utils::OrderedBudget budget(opts->max_fetch_text_len, text);
+  utils::ParallelFor(n, workers, [&](int worker, size_t idx) {
+    size_t max_len = budget.Remaining(idx);
+    if (max_len == 0) {
+      budget.Skip(idx);
+      return;
     }
 
-    append_text(text, &max_len, lr, rl - lr);
-    if (max_len > 0) {
-      text->push_back('\n');
-      max_len -= 1;
+    ZipHelper *z = &zip;
+    if (worker != 0) {
+      if (zips[worker] == nullptr) {
+        zips[worker].reset(new ZipHelper);
+        if (zips[worker]->OpenFromBytes(zip.Data(), zip.DataLen()) != 0) {
+          zips[worker].reset();
+        }
+      }
+      z = zips[worker].get();
+    }
+    if (z == nullptr) {
+      budget.Skip(idx);
+      return;
+    }
+
+    std::string part_text;
+    fn(*z, idx, &max_len, &part_text, &stats[idx]);
+    budget.Commit(idx, std::move(part_text));
+  });
+
+  if (opts->xml_part_stats != nullptr) {
+    for (auto &st : stats) {
+      if (!st.name.empty()) {
+        opts->xml_part_stats->push_back(std::move(st));
+      }
     }
   }
+}
+
+// =============================================================================
 
+template <typename XmlSource>
+static void docx_fetch_text(XmlSource *src, size_t *max_len,
+                            std::string *text) {
+  xml_token_t tok;
+  bool in_t = false;
+  while (*max_len > 0 && src->Next(&tok)) {
+    if (is_start(tok, "w:t")) {
+      in_t = !tok.self_closing;
+      if (tok.self_closing) {
+        append_newline(text, max_len);
+      }
+    } else if (is_end(tok, "w:t")) {
+      if (in_t) {
+        append_newline(text, max_len);
+      }
+      in_t = false;
+    } else if (in_t && tok.type == kXmlTokenText) {
+      append_text(text, max_len, tok.text.data(), tok.text.size());
+    }
+  }
+}
+
+int MsDOCxFetchText(const char *xml, size_t xml_len,
+                    const fetch_text_options_t *opts, std::string *text) {
+  if (opts == nullptr) {
+    opts = &__defaultFetchTextOptions;
+  }
+  size_t max_len = opts->max_fetch_text_len;
+
+  XmlTokenizer tz(xml, xml_len);
+  docx_fetch_text(&tz, &max_len, text);
   return 0;
 }
 
@@ -283,366 +424,401 @@ int MsDOCxFetchText(ZipHelper &zip, const fetch_text_options_t *opts,
   if (opts == nullptr) {
     opts = &__defaultFetchTextOptions;
   }
-  std::string xml_text;
-  if (zip.ReadByName("word/document.xml", opts->xml_max_file_len, &xml_text) !=
-      0) {
+  size_t max_len = opts->max_fetch_text_len;
+
+  ZipXmlReader reader;
+  if (open_part(&reader, zip, "word/document.xml", opts) != 0) {
     return -1;
   }
-  return MsDOCxFetchText(&xml_text[0], opts, text);
+  docx_fetch_text(&reader, &max_len, text);
+  report_part(reader, opts);
+  return 0;
 }
 
 // =============================================================================
 
-int MsPPTxFetchText(char *xml_text, const fetch_text_options_t *opts,
-                    std::string *text, size_t *fetch_len) {
+template <typename XmlSource>
+static void pptx_fetch_text(XmlSource *src, size_t *max_len,
+                            std::string *text) {
+  xml_token_t tok;
+  bool in_p = false;
+  bool in_t = false;
+  bool has_text = false;
+  while (*max_len > 0 && src->Next(&tok)) {
+    if (is_start(tok, "a:p")) {
+      in_p = !tok.self_closing;
+      has_text = false;
+    } else if (is_end(tok, "a:p")) {
+      if (in_p && has_text) {
+        append_newline(text, max_len);
+      }
+      in_p = false;
+    } else if (!in_p) {
+      continue;
+    } else if (is_start(tok, "a:br")) {
+      has_text = true;
+      append_newline(text, max_len);
+    } else if (is_start(tok, "a:t")) {
+      in_t = !tok.self_closing;
+      has_text = true;
+    } else if (is_end(tok, "a:t")) {
+      in_t = false;
+    } else if (in_t && tok.type == kXmlTokenText) {
+      append_text(text, max_len, tok.text.data(), tok.text.size());
+    }
+  }
+}
+
+int MsPPTxFetchText(const char *xml, size_t xml_len,
+                    const fetch_text_options_t *opts, std::string *text,
+                    size_t *fetch_len) {
   if (opts == nullptr) {
     opts = &__defaultFetchTextOptions;
   }
+  size_t max_len = opts->max_fetch_text_len;
+
+  XmlTokenizer tz(xml, xml_len);
+  pptx_fetch_text(&tz, &max_len, text);
 
   if (fetch_len != nullptr) {
-    *fetch_len = opts->max_fetch_text_len;
+    *fetch_len = opts->max_fetch_text_len - max_len;
   }
-  size_t max_len = opts->max_fetch_text_len;
+  return 0;
+}
 
-  const char *ap = nullptr;
-  size_t ap_len = 0;
-  for (bool f = find_tag(xml_text, "<a:p", &ap, &ap_len); f && max_len > 0;
-       f = find_tag(ap + ap_len, "<a:p", &ap, &ap_len)) {
-    const char *end_ap;
-    size_t end_ap_len = 0;
-    if (!find_tag(ap + ap_len, "</a:p", &end_ap, &end_ap_len)) {
-      break;
+// Slides named ppt/slides/slideN.xml, by N; for packages whose presentation
+// part does not list its slides.
+static void probe_slide_list(const ZipHelper &zip,
+                             std::vector<std::string> *slides) {
+  std::vector<std::pair<size_t, std::string>> found;
+  for (auto &i : zip.GetName2Idx()) {
+    size_t n;
+    int len = 0;
+    if (sscanf(i.first.c_str(), "ppt/slides/slide%zu.xml%n", &n, &len) == 1 &&
+        static_cast<size_t>(len) == i.first.length()) {
+      found.push_back({n, i.first});
     }
-    _temp_truncate_string(ap, end_ap - ap);
-
-    bool has_text = false;
-    const char *curr = ap + ap_len;
-    for (;;) {
-      const char *p = strstr(curr, "<a:");
-      if (p == nullptr) {
-        break;
+  }
+  std::sort(found.begin(), found.end());
+  for (auto &i : found) {
+    slides->push_back(std::move(i.second));
+  }
+}
+
+int MsPPTxFetchSlideList(ZipHelper &zip, const fetch_text_options_t *opts,
+                         std::vector<std::string> *slides) {
+  if (opts == nullptr) {
+    opts = &__defaultFetchTextOptions;
+  }
+  slides->clear();
+
+  std::map<std::string, std::string> rid2target;
+  ZipXmlReader reader;
+  if (fetch_relationships(zip, "ppt/_rels/presentation.xml.rels", "ppt/", opts,
+                          &rid2target) != 0 ||
+      open_part(&reader, zip, "ppt/presentation.xml", opts) != 0) {
+    probe_slide_list(zip, slides);
+    return 0;
+  }
+
+  xml_token_t tok;
+  bool found = false;
+  while (reader.Next(&tok)) {
+    if (is_xstart(tok, "sldIdLst")) {
+      found = !tok.self_closing;
+    } else if (is_xend(tok, "sldIdLst")) {
+      break;
+    } else if (found && is_xstart(tok, "sldId")) {
+      std::string_view rid;
+      if (!XmlAttrValue(tok.attrs, "r:id", &rid)) {
+        continue;
       }
-      curr = p + 1;
-
-      if (is_tag(p, "<a:br")) {
-        has_text = true;
-
-        text->push_back('\n');
-        max_len -= 1;
-      } else if (is_tag(p, "<a:t")) {
-        const char *q = strchr(p, '>');
-        if (q != nullptr) {
-          q += 1;
-          const char *at;
-          size_t at_len = 0;
-          if (find_tag(q, "</a:t", &at, &at_len)) {
-            has_text = true;
-
-            append_text(text, &max_len, q, at - q);
-          }
-        }
+      auto it = rid2target.find(std::string(rid));
+      if (it != rid2target.end() &&
+          zip.GetName2Idx().count(it->second) != 0) {
+        slides->push_back(it->second);
       }
     }
-
-    if (has_text && max_len > 0) {
-      text->push_back('\n');
-      max_len -= 1;
-    }
   }
+  report_part(reader, opts);
 
-  if (fetch_len != nullptr) {
-    *fetch_len -= max_len;
+  if (!found) {
+    probe_slide_list(zip, slides);
   }
-
   return 0;
 }
 
-int MsPPTxFetchText(ZipHelper &zip, const fetch_text_options_t *_opts,
+int MsPPTxFetchText(ZipHelper &zip, const fetch_text_options_t *opts,
                     std::string *text) {
-  fetch_text_options_t opts =
-      _opts == nullptr ? __defaultFetchTextOptions : *_opts;
-
-  std::vector<char> name(128);
-  std::string xml;
-  for (size_t i = 1; opts.max_fetch_text_len > 0; ++i) {
-    snprintf(name.data(), name.size(), "ppt/slides/slide%ld.xml", i);
-    if (zip.ReadByName(name.data(), opts.xml_max_file_len, &xml) != 0) {
-      break;
-    }
+  if (opts == nullptr) {
+    opts = &__defaultFetchTextOptions;
+  }
+
+  std::vector<std::string> slides;
+  MsPPTxFetchSlideList(zip, opts, &slides);
 
-    size_t fetch_len;
-    if (MsPPTxFetchText(&xml[0], &opts, text, &fetch_len) != 0) {
-      return -1;
+  auto fetch_slide = [&](ZipHelper &z, size_t idx, size_t *max_len,
+                         std::string *slide_text, part_stat_t *stat) {
+    ZipXmlReader reader;
+    if (open_part(&reader, z, slides[idx], opts) == 0) {
+      pptx_fetch_text(&reader, max_len, slide_text);
+      *stat = reader.Stat();
     }
-    opts.max_fetch_text_len -= fetch_len;
-  }
+  };
+  fetch_parts(zip, slides.size(), opts, fetch_slide, text);
   return 0;
 }
 
 // =============================================================================
 
-struct xlsx_tags_t {
-  const char *sheets;
-  const char *sheets_;
-  const char *sheet;
-  const char *si;
-  const char *si_;
-  const char *t;
-  const char *t_;
-  const char *row;
-  const char *row_;
-  const char *c;
-  const char *c_;
-  const char *v;
-  const char *v_;
-};
-
-static const xlsx_tags_t g_xlsxTags{
-    .sheets = "<sheets",
-    .sheets_ = "</sheets",
-    .sheet = "<sheet",
-    .si = "<si",
-    .si_ = "</si",
-    .t = "<t",
-    .t_ = "</t",
-    .row = "<row",
-    .row_ = "</row",
-    .c = "<c",
-    .c_ = "</c",
-    .v = "<v",
-    .v_ = "</v",
-};
-
-static const xlsx_tags_t g_xlsxXTags{
-    .sheets = "<x:sheets",
-    .sheets_ = "</x:sheets",
-    .sheet = "<x:sheet",
-    .si = "<x:si",
-    .si_ = "</x:si",
-    .t = "<x:t",
-    .t_ = "</x:t",
-    .row = "<x:row",
-    .row_ = "</x:row",
-    .c = "<x:c",
-    .c_ = "</x:c",
-    .v = "<x:v",
-    .v_ = "</x:v",
-};
-
-int MsXLSxFetchRelationships(ZipHelper &zip, size_t xml_max_file_len,
+int MsXLSxFetchRelationships(ZipHelper &zip, const fetch_text_options_t *opts,
                              std::map<std::string, std::string> *rid2target) {
-  std::string xml;
-  if (zip.ReadByName("xl/_rels/workbook.xml.rels", xml_max_file_len, &xml) !=
-      0) {
-    return -1;
-  }
+  return fetch_relationships(zip, "xl/_rels/workbook.xml.rels", "xl/", opts,
+                             rid2target);
+}
 
-  const char *rels = nullptr;
-  size_t rels_len = 0;
-  const char *rels_end = nullptr;
-  size_t rels_end_len = 0;
-  if (!find_tag(xml.c_str(), "<Relationships", &rels, &rels_len) ||
-      !find_tag(rels + rels_len, "</Relationships", &rels_end, &rels_end_len)) {
+int MsXLSxFetchSheetBarList(ZipHelper &zip, const fetch_text_options_t *opts,
+                            std::vector<xlsx_sheet_bar_t> *sheets,
+                            bool *is_xtag) {
+  ZipXmlReader reader;
+  if (open_part(&reader, zip, "xl/workbook.xml", opts) != 0) {
     return -1;
   }
-  _temp_truncate_string(rels, rels_end - rels);
-
-  const char *rel = nullptr;
-  size_t rel_len = 0;
-  for (bool f = find_tag(rels + rels_len, "<Relationship", &rel, &rel_len); f;
-       f = find_tag(rel + rel_len, "<Relationship", &rel, &rel_len)) {
-    std::string rid;
-    std::string target;
-    if (get_attr_value(rel, rel_len, "Id=", &rid) &&
-        get_attr_value(rel, rel_len, "Target=", &target) && !rid.empty() &&
-        !target.empty()) {
-      if (target[0] == '/') {
-        target.erase(0, 1);
-      } else {
-        target = "xl/" + target;
+  sheets->clear();
+
+  xml_token_t tok;
+  bool found = false;
+  while (reader.Next(&tok)) {
+    if (is_xstart(tok, "sheets")) {
+      found = true;
+      if (is_xtag != nullptr) {
+        *is_xtag = tok.name.size() != 6;
+      }
+    } else if (is_xend(tok, "sheets")) {
+      break;
+    } else if (found && is_xstart(tok, "sheet")) {
+      std::string_view rid;
+      std::string_view name;
+      std::string_view state;
+      if (XmlAttrValue(tok.attrs, "r:id", &rid) &&
+          XmlAttrValue(tok.attrs, "name", &name)) {
+        xlsx_sheet_bar_t s;
+        s.rid = rid;
+        s.name = name;
+        s.state = XmlAttrValue(tok.attrs, "state", &state) ? state : "visible";
+        sheets->push_back(std::move(s));
       }
-      rid2target->insert({rid, target});
     }
   }
-  return 0;
+  report_part(reader, opts);
+  return found ? 0 : -1;
 }
 
-static int ms_xlsx_fetch_sheet_bar_list(const std::string &xml,
-                                        const xlsx_tags_t &t,
-                                        std::vector<xlsx_sheet_bar_t> *sheets) {
-  sheets->clear();
-
-  const char *shts = nullptr;
-  size_t shts_len = 0;
-  const char *shts_end = nullptr;
-  size_t shts_end_len = 0;
-  if (!find_tag(xml.c_str(), t.sheets, &shts, &shts_len) ||
-      !find_tag(shts + shts_len, t.sheets_, &shts_end, &shts_end_len)) {
-    return -1;
-  }
-  _temp_truncate_string(shts, shts_end - shts);
-
-  const char *sht = nullptr;
-  size_t sht_len = 0;
-  for (bool f = find_tag(shts + shts_len, t.sheet, &sht, &sht_len); f;
-       f = find_tag(sht + sht_len, t.sheet, &sht, &sht_len)) {
-    xlsx_sheet_bar_t s;
-    if (get_attr_value(sht, sht_len, "r:id=", &s.rid) &&
-        get_attr_value(sht, sht_len, "name=", &s.name)) {
-      if (!get_attr_value(sht, sht_len, "state=", &s.state)) {
-        s.state = "visible";
-      }
-      sheets->push_back(std::move(s));
+// The text of an <si> is the concatenation of its <t> runs; phonetic
+// readings (<rPh>) are left out. Reads up to the matching </si>; with a null
+// str the text is only skipped.
+template <typename XmlSource>
+static void xlsx_fetch_si(XmlSource *src, std::string *str) {
+  xml_token_t tok;
+  bool in_t = false;
+  int rph_depth = 0;
+  while (src->Next(&tok)) {
+    if (is_xend(tok, "si")) {
+      break;
+    } else if (is_xstart(tok, "rPh") && !tok.self_closing) {
+      rph_depth += 1;
+    } else if (is_xend(tok, "rPh")) {
+      rph_depth -= 1;
+    } else if (is_xstart(tok, "t")) {
+      in_t = !tok.self_closing && rph_depth == 0;
+    } else if (is_xend(tok, "t")) {
+      in_t = false;
+    } else if (in_t && tok.type == kXmlTokenText && str != nullptr) {
+      str->append(tok.text);
     }
   }
-  return 0;
 }
 
-int MsXLSxFetchSheetBarList(ZipHelper &zip, size_t xml_max_file_len,
-                            std::vector<xlsx_sheet_bar_t> *sheets,
-                            bool *is_xtag) {
-  std::string xml;
-  if (zip.ReadByName("xl/workbook.xml", xml_max_file_len, &xml) != 0) {
+// Lazy mode keeps the raw part and the offset just past every <si> start tag;
+// an entry is tokenized again when it is looked up. Returns -1 without
+// reading anything if the part is over opts->lazy_sst_max_part_len.
+static int xlsx_fetch_lazy_sst(ZipHelper &zip, const std::string &name,
+                               const fetch_text_options_t *opts,
+                               size_t max_sst_cnt, SharedStrings *sst) {
+  zip_file_t *zfile;
+  size_t size;
+  if (zip.OpenByName(name, &zfile, &size) != 0) {
+    return 0;
+  }
+  _defer([&](...) { zip_fclose(zfile); });
+  if (std::min(size, opts->xml_max_file_len) > opts->lazy_sst_max_part_len) {
     return -1;
   }
-  sheets->clear();
 
-  if (ms_xlsx_fetch_sheet_bar_list(xml, g_xlsxTags, sheets) != 0) {
-    if (is_xtag != nullptr) {
-      *is_xtag = true;
-    }
-    return ms_xlsx_fetch_sheet_bar_list(xml, g_xlsxXTags, sheets);
-  } else {
-    if (is_xtag != nullptr) {
-      *is_xtag = false;
-    }
+  auto xml = std::make_shared<std::string>();
+  xml->resize(std::min(size, opts->xml_max_file_len));
+  zip_int64_t n = xml->empty() ? 0 : zip_fread(zfile, &(*xml)[0], xml->size());
+  if (n < 0) {
     return 0;
   }
-}
-
-static size_t ms_xlsx_fetch_sst(const std::string &xml, const xlsx_tags_t &tags,
-                                int max_sst_cnt,
-                                std::vector<std::string> *sst) {
-  sst->clear();
+  xml->resize(n);
+  if (opts->xml_part_stats != nullptr) {
+    opts->xml_part_stats->push_back(
+        part_stat_t{name, xml->size(), size, false});
+  }
 
-  const char *si = nullptr;
-  size_t si_len = 0;
-  for (bool f = find_tag(xml.c_str(), tags.si, &si, &si_len);
-       f && sst->size() < static_cast<size_t>(max_sst_cnt);
-       f = find_tag(si + si_len, tags.si, &si, &si_len)) {
-    const char *si_end = nullptr;
-    size_t si_end_len = 0;
-    if (!find_tag(si + si_len, tags.si_, &si_end, &si_end_len)) {
-      break;
-    }
-    _temp_truncate_string(si, si_end - si);
-
-    const char *t = nullptr;
-    size_t t_len = 0;
-    const char *t_end = nullptr;
-    size_t t_end_len = 0;
-    if (!find_tag(si + si_len, tags.t, &t, &t_len) ||
-        !find_tag(t + t_len, tags.t_, &t_end, &t_end_len)) {
+  std::vector<size_t> pos;
+  XmlTokenizer tz(xml->data(), xml->size());
+  xml_token_t tok;
+  while (tz.Next(&tok)) {
+    if (!is_xstart(tok, "si")) {
+      continue;
+    } else if (pos.size() >= max_sst_cnt) {
       break;
+    } else if (tok.self_closing) {
+      pos.push_back(xml->size());
+    } else {
+      pos.push_back(tz.Offset());
+      xlsx_fetch_si(&tz, nullptr);
     }
-    sst->push_back(std::string(t + t_len, t_end - (t + t_len)));
   }
 
-  return sst->size();
+  size_t cnt = pos.size();
+  sst->SetLazy(
+      cnt,
+      [xml, pos = std::move(pos)](size_t idx, std::string *str) {
+        XmlTokenizer si(xml->data() + pos[idx], xml->size() - pos[idx]);
+        xlsx_fetch_si(&si, str);
+        return 0;
+      },
+      opts->sst_cache_size);
+  return 0;
 }
 
-int MsXLSxFetchSST(ZipHelper &zip, size_t xml_max_file_len, int max_sst_cnt,
-                   std::vector<std::string> *sst) {
-  std::string xml;
-  if (zip.ReadByName("xl/sharedStrings.xml", xml_max_file_len, &xml) != 0) {
-    return 0;
-  }
+int MsXLSxFetchSST(ZipHelper &zip, const fetch_text_options_t *opts,
+                   SharedStrings *sst) {
+  sst->Clear();
 
+  int max_sst_cnt = opts->xls_max_sst_cnt;
   if (max_sst_cnt <= 0) {
     max_sst_cnt = std::numeric_limits<int>::max();
   }
 
-  if (ms_xlsx_fetch_sst(xml, g_xlsxTags, max_sst_cnt, sst) == 0) {
-    ms_xlsx_fetch_sst(xml, g_xlsxXTags, max_sst_cnt, sst);
+  const std::string name = "xl/sharedStrings.xml";
+  if (opts->lazy_sst &&
+      xlsx_fetch_lazy_sst(zip, name, opts, max_sst_cnt, sst) == 0) {
+    return 0;
+  }
+
+  ZipXmlReader reader;
+  if (open_part(&reader, zip, name, opts) != 0) {
+    return 0;
+  }
+
+  xml_token_t tok;
+  while (reader.Next(&tok)) {
+    if (!is_xstart(tok, "si")) {
+      continue;
+    } else if (sst->Size() >= static_cast<size_t>(max_sst_cnt)) {
+      break;
+    }
+    std::string *str = sst->Open();
+    if (!tok.self_closing) {
+      xlsx_fetch_si(&reader, str);
+    }
+    sst->Close();
   }
+  report_part(reader, opts);
   return 0;
 }
 
-static int ms_xlsx_fetch_text(const char *xml,
-                              const std::vector<std::string> &sst,
-                              const std::string &delimiter,
-                              const xlsx_tags_t &tags, size_t *max_len,
+// Reads a shared-string index like atoi, but without copying the value. A
+// negative or overflowing index is out of range.
+static size_t parse_sst_index(std::string_view s) {
+  size_t pos = s.find_first_not_of(" \t\r\n");
+  s.remove_prefix(pos == std::string_view::npos ? s.size() : pos);
+  if (!s.empty() && s.front() == '-') {
+    return std::numeric_limits<size_t>::max();
+  } else if (!s.empty() && s.front() == '+') {
+    s.remove_prefix(1);
+  }
+
+  size_t idx = 0;
+  auto r = std::from_chars(s.data(), s.data() + s.size(), idx);
+  if (r.ec == std::errc::result_out_of_range) {
+    return std::numeric_limits<size_t>::max();
+  }
+  return r.ec == std::errc() ? idx : 0;
+}
+
+// Cell values are appended as their text tokens arrive; only the index of a
+// shared-string cell is collected until the cell ends.
+static int ms_xlsx_fetch_text(ZipXmlReader *reader, const SharedStrings &sst,
+                              const std::string &delimiter, size_t *max_len,
                               std::string *text) {
+  static const std::string_view ignore_str = "_";
   size_t delimiter_len = utils::count_utf8_word_cnt(delimiter);
-  const char *row = nullptr;
-  size_t row_len = 0;
-  for (bool f = find_tag(xml, tags.row, &row, &row_len); f && *max_len > 0;
-       f = find_tag(row + row_len, tags.row, &row, &row_len)) {
-    if (is_empty_element_tag(row, row_len)) {
-      continue;
-    }
 
-    const char *row_end = nullptr;
-    size_t row_end_size = 0;
-    if (!find_tag(row + row_len, tags.row_, &row_end, &row_end_size)) {
-      return -1;
-    }
-    _temp_truncate_string(row, row_end - row);
-
-    bool empty_row = true;
-    const char *c = nullptr;
-    size_t c_len = 0;
-    for (bool fc = find_tag(row + row_len, tags.c, &c, &c_len);
-         fc && *max_len > 0 && c < row_end;
-         fc = find_tag(c + c_len, tags.c, &c, &c_len)) {
-      if (is_empty_element_tag(c, c_len)) {
-        continue;
+  xml_token_t tok;
+  bool in_row = false;
+  bool empty_row = true;
+  bool in_c = false;
+  bool is_sst = false;
+  bool in_v = false;
+  bool has_v = false;
+  std::string sst_idx;
+  std::string sst_buf;
+  while (*max_len > 0 && reader->Next(&tok)) {
+    if (is_xstart(tok, "row")) {
+      in_row = !tok.self_closing;
+      empty_row = true;
+    } else if (is_xend(tok, "row")) {
+      if (in_row && !empty_row) {
+        append_newline(text, max_len);
       }
-
-      const char *c_end = nullptr;
-      size_t c_end_len = 0;
-      if (!find_tag(c + c_len, tags.c_, &c_end, &c_end_len)) {
-        return -1;
-      }
-      _temp_truncate_string(c, c_end - c);
-
-      const char *v = nullptr;
-      size_t v_len = 0;
-      const char *v_end = nullptr;
-      size_t v_end_len = 0;
-      if (!find_tag(c + c_len, tags.v, &v, &v_len) ||
-          !find_tag(v + v_len, tags.v_, &v_end, &v_end_len)) {
-        return -1;
-      }
-      std::string val(v + v_len, v_end - (v + v_len));
-
-      static const std::string ignore_str = "_";
-      const std::string *cell_text = &val;
-      {
-        _temp_truncate_string(c, c_len);
-        if (is_sst_tag(c, c_len)) {
-          size_t id = atoi(val.c_str());
-          cell_text = id >= sst.size() ? &ignore_str : &sst[id];
-        }
+      in_row = false;
+    } else if (!in_row) {
+      continue;
+    } else if (is_xstart(tok, "c")) {
+      std::string_view t;
+      in_c = !tok.self_closing;
+      is_sst = XmlAttrValue(tok.attrs, "t", &t) && t == "s";
+      has_v = false;
+      sst_idx.clear();
+    } else if (is_xstart(tok, "v") && in_c) {
+      in_v = !tok.self_closing;
+      if (has_v) {
+        continue;
       }
-
+      has_v = true;
       if (!empty_row) {
         append_text(text, max_len, delimiter.c_str(), delimiter.length(),
                     delimiter_len);
-        if (max_len == 0) {
-          return 0;
-        }
-      }
-      append_text(text, max_len, cell_text->c_str(), cell_text->length());
-      if (max_len == 0) {
-        return 0;
       }
       empty_row = false;
-    }
+    } else if (is_xend(tok, "v")) {
+      in_v = false;
+    } else if (in_v && tok.type == kXmlTokenText) {
+      if (is_sst) {
+        sst_idx.append(tok.text);
+      } else {
+        append_text(text, max_len, tok.text.data(), tok.text.size());
+      }
+    } else if (is_xend(tok, "c") && in_c) {
+      in_c = false;
+      if (!has_v || !is_sst) {
+        continue;
+      }
 
-    if (*max_len > 0 && !empty_row) {
-      text->push_back('\n');
-      *max_len -= 1;
+      std::string_view cell_text;
+      size_t cell_cch;
+      if (sst.Lookup(parse_sst_index(sst_idx), &sst_buf, &cell_text,
+                     &cell_cch) != 0) {
+        cell_text = ignore_str;
+        cell_cch = 1;
+      }
+      append_text(text, max_len, cell_text.data(), cell_text.length(),
+                  cell_cch);
     }
   }
   return 0;
@@ -654,57 +830,44 @@ int MsXLSxFetchText(ZipHelper &zip, const fetch_text_options_t *opts,
     opts = &__defaultFetchTextOptions;
   }
 
-  std::vector<std::string> sst;
-  if (MsXLSxFetchSST(zip, opts->xml_max_file_len, opts->xls_max_sst_cnt,
-                     &sst) != 0) {
+  SharedStrings sst;
+  if (MsXLSxFetchSST(zip, opts, &sst) != 0) {
     return -1;
   }
 
   std::map<std::string, std::string> rid2target;
-  if (MsXLSxFetchRelationships(zip, opts->xml_max_file_len, &rid2target) != 0) {
+  if (MsXLSxFetchRelationships(zip, opts, &rid2target) != 0) {
     return -1;
   }
 
-  bool is_xtag;
   std::vector<xlsx_sheet_bar_t> sheets;
-  if (MsXLSxFetchSheetBarList(zip, opts->xml_max_file_len, &sheets, &is_xtag) !=
-      0) {
+  if (MsXLSxFetchSheetBarList(zip, opts, &sheets) != 0) {
     return -1;
   }
 
-  size_t max_len = opts->max_fetch_text_len;
-  std::vector<char> name(128);
-  std::string xml;
+  std::vector<const xlsx_sheet_bar_t *> visible;
   for (auto &sht : sheets) {
-    if (sht.state != "visible") {
-      continue;
+    if (sht.state == "visible") {
+      visible.push_back(&sht);
     }
+  }
 
-    append_text(text, &max_len, sht.name.c_str(), sht.name.length());
-    if (max_len > 0) {
-      text->push_back('\n');
-      max_len -= 1;
-    }
-    if (max_len == 0) {
-      break;
-    }
+  auto fetch_sheet = [&](ZipHelper &z, size_t idx, size_t *max_len,
+                         std::string *sheet_text, part_stat_t *stat) {
+    const xlsx_sheet_bar_t &sht = *visible[idx];
+    append_text(sheet_text, max_len, sht.name.c_str(), sht.name.length());
+    append_newline(sheet_text, max_len);
 
     auto it = rid2target.find(sht.rid);
-    if (it == rid2target.end() || it->second.empty()) {
-      continue;
+    ZipXmlReader reader;
+    if (*max_len > 0 && it != rid2target.end() && !it->second.empty() &&
+        open_part(&reader, z, it->second, opts) == 0) {
+      ms_xlsx_fetch_text(&reader, sst, opts->xls_delimiter, max_len,
+                         sheet_text);
+      *stat = reader.Stat();
     }
-    if (zip.ReadByName(it->second, opts->xml_max_file_len, &xml) != 0) {
-      continue;
-    }
-
-    ms_xlsx_fetch_text(xml.c_str(), sst, opts->xls_delimiter,
-                       is_xtag ? g_xlsxXTags : g_xlsxTags, &max_len, text);
-
-    if (max_len == 0) {
-      break;
-    }
-  }
-
+  };
+  fetch_parts(zip, visible.size(), opts, fetch_sheet, text);
   return 0;
 }
 
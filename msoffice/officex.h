@@ -7,7 +7,9 @@
 #include <string>
 #include <vector>
 
+#include "msoffice/shared_strings.h"
 #include "msoffice/utils.h"
+#include "msoffice/xml_tokenizer.h"
 
 namespace msoffice {
 
@@ -29,25 +31,86 @@ class ZipHelper {
   int ReadByName(const std::string &name, size_t max_read_len,
                  std::string *data);
 
+  // Opens an entry for reading; the caller closes it with zip_fclose.
+  int OpenByName(const std::string &name, zip_file_t **zfile,
+                 size_t *size) const;
+
   inline const std::map<std::string, int64_t> &GetName2Idx() const {
     return m_name2idx;
   }
 
+  // The archive bytes, borrowed from the caller; another ZipHelper can be
+  // opened over them for use on a different thread.
+  inline const char *Data() const {
+    return m_data;
+  }
+  inline size_t DataLen() const {
+    return m_data_len;
+  }
+
  private:
+  const char *m_data;
+  size_t m_data_len;
   zip_source_t *m_zsrc;
   zip_t *m_zfd;
   std::map<std::string, int64_t> m_name2idx;
 };
 
+// Streams the XML of one zip entry as tokens through a buffer of at most
+// window_size bytes, so memory stays flat however large the entry is, and
+// parsing can stop long before the entry is fully decompressed. A single
+// tag, comment or CDATA section larger than the window ends the stream with
+// Overflow() set. Token views stay valid until the next call to Next().
+class ZipXmlReader {
+ public:
+  ZipXmlReader();
+  ~ZipXmlReader();
+
+  ZipXmlReader(const ZipXmlReader &) = delete;
+  ZipXmlReader &operator=(const ZipXmlReader &) = delete;
+
+  int Open(const ZipHelper &zip, const std::string &name, size_t max_read_len,
+           size_t window_size = 64 * 1024);
+  bool Next(xml_token_t *tok);
+
+  inline bool Overflow() const {
+    return m_overflow;
+  }
+  // Bytes inflated so far against the uncompressed size of the entry.
+  inline part_stat_t Stat() const {
+    return part_stat_t{m_name, m_read, m_size, m_overflow};
+  }
+
+ private:
+  int fill();
+
+ private:
+  zip_file_t *m_zfile;
+  std::string m_name;
+  size_t m_size;
+  size_t m_read;
+  size_t m_max_read_len;
+  size_t m_window_size;
+  bool m_eof;
+  bool m_overflow;
+  std::string m_buf;
+  XmlTokenizer m_tz;
+};
+
 int MsDOCxFetchText(ZipHelper &zip, const fetch_text_options_t *opts,
                     std::string *text);
-int MsDOCxFetchText(char *xml_text, const fetch_text_options_t *opts,
-                    std::string *text);
+int MsDOCxFetchText(const char *xml, size_t xml_len,
+                    const fetch_text_options_t *opts, std::string *text);
 
+// Slide parts in presentation order, from the slide list in
+// ppt/presentation.xml; falls back to ppt/slides/slideN.xml by N.
+int MsPPTxFetchSlideList(ZipHelper &zip, const fetch_text_options_t *opts,
+                         std::vector<std::string> *slides);
 int MsPPTxFetchText(ZipHelper &zip, const fetch_text_options_t *opts,
                     std::string *text);
-int MsPPTxFetchText(char *xml_text, const fetch_text_options_t *opts,
-                    std::string *text, size_t *fetch_len = nullptr);
+int MsPPTxFetchText(const char *xml, size_t xml_len,
+                    const fetch_text_options_t *opts, std::string *text,
+                    size_t *fetch_len = nullptr);
 
 struct xlsx_sheet_bar_t {
   std::string rid;
@@ -55,15 +118,15 @@ struct xlsx_sheet_bar_t {
   std::string state;
 };
 
-int MsXLSxFetchRelationships(ZipHelper &zip, size_t xml_max_file_len,
+int MsXLSxFetchRelationships(ZipHelper &zip, const fetch_text_options_t *opts,
                              std::map<std::string, std::string> *rid2target);
 
-int MsXLSxFetchSheetBarList(ZipHelper &zip, size_t xml_max_file_len,
+int MsXLSxFetchSheetBarList(ZipHelper &zip, const fetch_text_options_t *opts,
                             std::vector<xlsx_sheet_bar_t> *sheets,
                             bool *is_xtag = nullptr);
 
-int MsXLSxFetchSST(ZipHelper &zip, size_t xml_max_file_len, int max_sst_cnt,
-                   std::vector<std::string> *sst);
+int MsXLSxFetchSST(ZipHelper &zip, const fetch_text_options_t *opts,
+                   SharedStrings *sst);
 int MsXLSxFetchText(ZipHelper &zip, const fetch_text_options_t *opts,
                     std::string *text);
 
@@ -0,0 +1,94 @@
+#include "msoffice/shared_strings.h"
+
+#include <algorithm>
+
+#include "utils/utils.h"
+
+namespace msoffice {
+
+void SharedStrings::Reserve(size_t n, size_t bytes) {
+  m_index.reserve(n);
+  m_arena.reserve(bytes);
+}
+
+void SharedStrings::Clear() {
+  m_arena.clear();
+  m_index.clear();
+  m_open = false;
+  m_lazy_size = 0;
+  m_decode = nullptr;
+  m_cache.clear();
+}
+
+void SharedStrings::SetLazy(size_t n, decode_fn_t decode, size_t cache_size) {
+  Clear();
+  m_lazy_size = n;
+  m_decode = std::move(decode);
+  m_cache.resize(std::max(cache_size, static_cast<size_t>(1)));
+}
+
+int SharedStrings::Lookup(size_t idx, std::string *buf, std::string_view *s,
+                          size_t *cch) const {
+  if (idx >= Size()) {
+    return -1;
+  }
+  if (!Lazy()) {
+    *s = Get(idx);
+    *cch = Cch(idx);
+    return 0;
+  }
+
+  // Entries are immutable once installed, so a hit holds its own reference
+  // and copies without the lock.
+  size_t slot = idx % m_cache.size();
+  std::shared_ptr<const cache_entry_t> e;
+  {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    e = m_cache[slot];
+  }
+  if (e != nullptr && e->idx == idx) {
+    buf->assign(e->str);
+    *s = *buf;
+    *cch = e->cch;
+    return 0;
+  }
+
+  buf->clear();
+  if (m_decode(idx, buf) != 0) {
+    return -1;
+  }
+  *s = *buf;
+  *cch = utils::count_utf8_word_cnt(buf->data(), buf->size());
+  e = std::make_shared<const cache_entry_t>(cache_entry_t{idx, *cch, *buf});
+  {
+    std::lock_guard<std::mutex> lock(m_cache_mutex);
+    m_cache[slot].swap(e);
+  }
+  return 0;
+}
+
+std::string *SharedStrings::Open() {
+  Close();
+  m_index.push_back(entry_t{m_arena.size(), 0, 0});
+  m_open = true;
+  return &m_arena;
+}
+
+void SharedStrings::Close() {
+  if (!m_open) {
+    return;
+  }
+  entry_t &e = m_index.back();
+  const char *s = m_arena.data() + e.offset;
+  size_t len = m_arena.size() - e.offset;
+  e.len = static_cast<uint32_t>(len);
+  e.cch = static_cast<uint32_t>(utils::count_utf8_word_cnt(s, len));
+  m_open = false;
+}
+
+void SharedStrings::Add(std::string_view s) {
+  Open()->append(s);
+  Close();
+}
+
+}  // namespace msoffice
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace msoffice {
+
+// Shared-strings table (SST) of a workbook. All strings live back to back in
+// one arena; the index keeps their offset, byte length and UTF-8 character
+// count.
+//
+// In lazy mode only the number of strings is known up front. A string is
+// decoded the first time Lookup() asks for it and kept in a small
+// direct-mapped cache, so strings no cell refers to are never decoded. The
+// cache is shared by every thread calling Lookup(): its lock is held only to
+// read or replace a slot, while decoding and copying happen outside it. Two
+// threads missing the same string both decode it.
+class SharedStrings {
+ public:
+  typedef std::function<int(size_t idx, std::string *str)> decode_fn_t;
+
+  SharedStrings() = default;
+  SharedStrings(const SharedStrings &) = delete;
+  SharedStrings &operator=(const SharedStrings &) = delete;
+
+  void SetLazy(size_t n, decode_fn_t decode, size_t cache_size);
+  inline bool Lazy() const {
+    return m_decode != nullptr;
+  }
+
+  // Works in both modes and from several threads. The text is either a view
+  // of the arena or copied into buf.
+  int Lookup(size_t idx, std::string *buf, std::string_view *s,
+             size_t *cch) const;
+
+  void Reserve(size_t n, size_t bytes);
+  void Clear();
+
+  // Starts a new string. Its bytes are appended to the returned buffer, which
+  // stays valid until Close().
+  std::string *Open();
+  void Close();
+
+  void Add(std::string_view s);
+
+  inline size_t Size() const {
+    return Lazy() ? m_lazy_size : m_index.size();
+  }
+
+  // Eager mode only.
+  inline std::string_view Get(size_t idx) const {
+    const entry_t &e = m_index[idx];
+    return std::string_view(m_arena.data() + e.offset, e.len);
+  }
+  inline size_t Cch(size_t idx) const {
+    return m_index[idx].cch;
+  }
+
+ private:
+  struct entry_t {
+    size_t offset;
+    uint32_t len;
+    uint32_t cch;
+  };
+
+  struct cache_entry_t {
+    size_t idx;
+    size_t cch;
+    std::string str;
+  };
+
+  std::string m_arena;
+  std::vector<entry_t> m_index;
+  bool m_open = false;
+
+  size_t m_lazy_size = 0;
+  decode_fn_t m_decode;
+  mutable std::mutex m_cache_mutex;
+  mutable std::vector<std::shared_ptr<const cache_entry_t>> m_cache;
+};
+
+}  // namespace msoffice
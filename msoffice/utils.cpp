@@ -1,9 +1,12 @@
 #include "msoffice/utils.h"
 
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
-#include <codecvt>
-#include <locale>
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
 
 #define _STYLE_Impt "\e[3;35m"
 #define _STYLE_Info "\e[3;32m"
@@ -28,15 +31,85 @@ void RemoveControlCharacter(std::string *text) {
   }
 }
 
-int Utf16ToUtf8(const char16_t *begin, const char16_t *end, std::string *u8) {
-  std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> convert;
-  try {
-    *u8 = convert.to_bytes(begin, end);
-    return 0;
-  } catch (const std::exception &e) {
-    xmlog(Err, "u16_to_u8 err, %s", e.what());
-    return -1;
+static inline uint16_t load_u16(const char16_t *p) {
+  uint16_t c;
+  memcpy(&c, p, sizeof(c));
+  return c;
+}
+
+#if defined(__x86_64__)
+// Copies a run of ASCII, 8 code units at a time. Returns the end of the run
+// it handled; the caller deals with the first non-ASCII block.
+static const char16_t *append_ascii_sse2(const char16_t *p,
+                                         const char16_t *end, char **out) {
+  const __m128i mask = _mm_set1_epi16(static_cast<short>(0xFF80));
+  for (; end - p >= 8; p += 8) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i hi = _mm_and_si128(v, mask);
+    if (_mm_movemask_epi8(_mm_cmpeq_epi16(hi, _mm_setzero_si128())) !=
+        0xFFFF) {
+      break;
+    }
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(*out),
+                     _mm_packus_epi16(v, v));
+    *out += 8;
   }
+  return p;
+}
+#endif
+
+void AppendUtf16ToUtf8(const char16_t *begin, const char16_t *end,
+                       std::string *u8) {
+  if (end <= begin) {
+    return;
+  }
+
+  // No code unit needs more than 3 bytes; a surrogate pair takes 4 for 2.
+  size_t old_size = u8->size();
+  u8->resize(old_size + (end - begin) * 3);
+  char *out = &(*u8)[old_size];
+
+  for (const char16_t *p = begin; p < end;) {
+#if defined(__x86_64__)
+    p = append_ascii_sse2(p, end, &out);
+    if (p == end) {
+      break;
+    }
+#endif
+    uint32_t c = load_u16(p++);
+    if (c < 0x80) {
+      *out++ = c;
+      continue;
+    } else if (c < 0x800) {
+      *out++ = 0xC0 | (c >> 6);
+      *out++ = 0x80 | (c & 0x3F);
+      continue;
+    }
+
+    if (c >= 0xD800 && c <= 0xDFFF) {
+      uint32_t lo = p < end ? load_u16(p) : 0;
+      if (c <= 0xDBFF && lo >= 0xDC00 && lo <= 0xDFFF) {
+        c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+        p += 1;
+        *out++ = 0xF0 | (c >> 18);
+        *out++ = 0x80 | ((c >> 12) & 0x3F);
+        *out++ = 0x80 | ((c >> 6) & 0x3F);
+        *out++ = 0x80 | (c & 0x3F);
+        continue;
+      }
+      c = 0xFFFD;  // lone surrogate
+    }
+    *out++ = 0xE0 | (c >> 12);
+    *out++ = 0x80 | ((c >> 6) & 0x3F);
+    *out++ = 0x80 | (c & 0x3F);
+  }
+  u8->resize(out - u8->data());
+}
+
+int Utf16ToUtf8(const char16_t *begin, const char16_t *end, std::string *u8) {
+  u8->clear();
+  AppendUtf16ToUtf8(begin, end, u8);
+  return 0;
 }
 
 }  // namespace msoffice
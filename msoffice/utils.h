@@ -1,25 +1,82 @@
 #pragma once
 
+#include <stdint.h>
 #include <unistd.h>
 
 #include <limits>
 #include <string>
+#include <vector>
 
 namespace msoffice {
 
+// How much of one OOXML part was parsed.
+struct part_stat_t {
+  std::string name;
+  size_t bytes_read;   // inflated and tokenized
+  size_t bytes_total;  // uncompressed size of the part
+  bool overflow;       // stopped at a construct larger than the window
+};
+
+enum xls_num_format_t {
+  // "%.2f" for RK cells and numbers above 10, "%f" for the rest
+  kXlsNumLegacy = 0,
+  // xls_num_precision digits after the point
+  kXlsNumFixed = 1,
+  // shortest text that reads back as the same double
+  kXlsNumShortest = 2,
+};
+
+// Subdocuments of a .doc file, in the order they follow each other in the CP
+// space. Combined as a bit mask.
+enum doc_subdoc_t {
+  kDocSubdocMain = 1 << 0,
+  kDocSubdocFootnotes = 1 << 1,
+  kDocSubdocHeaders = 1 << 2,
+  kDocSubdocComments = 1 << 3,
+  kDocSubdocEndnotes = 1 << 4,
+  kDocSubdocTextboxes = 1 << 5,
+  kDocSubdocHeaderTextboxes = 1 << 6,
+  kDocSubdocAll = (1 << 7) - 1,
+};
+
 struct fetch_text_options_t {
   size_t max_fetch_text_len = std::numeric_limits<size_t>::max();
   bool fetch_text_from_drawing = false;
   std::string xls_delimiter = ",";
   bool xls_skip_blank_cell = true;
-  int xls_max_sst_cnt = 0xffff;
-  size_t xml_max_file_len = 1024 * 1024;
+  int xls_max_sst_cnt = 0xffff;  // <= 0: no limit
+  xls_num_format_t xls_num_format = kXlsNumLegacy;
+  int xls_num_precision = 2;
+  // doc_subdoc_t bits; pieces of other subdocuments are neither read nor
+  // counted against max_fetch_text_len.
+  uint32_t doc_subdocs = kDocSubdocAll;
+  // Shared strings are only located up front and decoded when a cell first
+  // refers to one; the last sst_cache_size decoded strings are kept. Pays off
+  // when the text budget is much smaller than the workbook. XLSX keeps the
+  // whole sharedStrings.xml in memory for this, so a part larger than
+  // lazy_sst_max_part_len is streamed eagerly instead.
+  bool lazy_sst = false;
+  size_t sst_cache_size = 256;
+  size_t lazy_sst_max_part_len = 16 * 1024 * 1024;
+  // OOXML parts are streamed through a buffer of xml_window_size bytes, so
+  // memory does not grow with the part. xml_max_file_len optionally stops
+  // reading a part early.
+  size_t xml_max_file_len = std::numeric_limits<size_t>::max();
+  size_t xml_window_size = 64 * 1024;
+  // If set, one entry is appended for every part read.
+  std::vector<part_stat_t>* xml_part_stats = nullptr;
+  // Threads parsing independent parts of one document (XLS/XLSX sheets,
+  // PPTX slides).
+  int part_workers = 1;
 };
 
 extern const fetch_text_options_t __defaultFetchTextOptions;
 
 void RemoveControlCharacter(std::string* text);
 
+// Appends UTF-16LE text to u8. Unpaired surrogates become U+FFFD.
+void AppendUtf16ToUtf8(const char16_t* begin, const char16_t* end,
+                       std::string* u8);
 int Utf16ToUtf8(const char16_t* begin, const char16_t* end, std::string* u8);
 
 }  // namespace msoffice
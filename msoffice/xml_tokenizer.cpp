@@ -0,0 +1,197 @@
+#include "msoffice/xml_tokenizer.h"
+
+#include <string.h>
+
+namespace msoffice {
+
+namespace officex {
+
+static inline bool is_space(char ch) {
+  return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+static inline bool is_name_end(char ch) {
+  return is_space(ch) || ch == '>' || ch == '/';
+}
+
+static inline bool starts_with(const char *p, const char *end,
+                               std::string_view prefix) {
+  return static_cast<size_t>(end - p) >= prefix.size() &&
+         memcmp(p, prefix.data(), prefix.size()) == 0;
+}
+
+XmlTokenizer::XmlTokenizer(const char *s, size_t len, bool more)
+    : m_begin(s), m_p(s), m_end(s + len), m_more(more), m_need_more(false) {}
+
+bool XmlTokenizer::skip_past(std::string_view end) {
+  std::string_view rest(m_p, m_end - m_p);
+  size_t pos = rest.find(end);
+  if (pos == std::string_view::npos) {
+    return false;
+  }
+  m_p += pos + end.size();
+  return true;
+}
+
+// Ends tokenizing at a construct starting at `start` that is not complete.
+bool XmlTokenizer::stop(const char *start) {
+  if (m_more) {
+    m_p = start;
+    m_need_more = true;
+  } else {
+    m_p = m_end;
+  }
+  return false;
+}
+
+// <!DOCTYPE ...> may carry an internal subset in [...] with its own tags.
+bool XmlTokenizer::skip_doctype() {
+  int depth = 0;
+  char quote = 0;
+  for (const char *p = m_p + 2; p < m_end; ++p) {
+    if (quote != 0) {
+      quote = *p == quote ? 0 : quote;
+    } else if (*p == '"' || *p == '\'') {
+      quote = *p;
+    } else if (*p == '[') {
+      depth += 1;
+    } else if (*p == ']') {
+      depth -= 1;
+    } else if (*p == '>' && depth <= 0) {
+      m_p = p + 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool XmlTokenizer::Next(xml_token_t *tok) {
+  while (m_p < m_end) {
+    const char *start = m_p;
+    if (*m_p != '<') {
+      const char *lt =
+          static_cast<const char *>(memchr(m_p, '<', m_end - m_p));
+      if (lt == nullptr && m_more) {
+        // Hold back the last character, it may not be complete yet.
+        for (lt = m_end - 1; lt > m_p && (*lt & 0xC0) == 0x80; --lt) {
+        }
+        if (lt == m_p) {
+          return stop(start);
+        }
+      } else if (lt == nullptr) {
+        lt = m_end;
+      }
+      tok->type = kXmlTokenText;
+      tok->text = std::string_view(m_p, lt - m_p);
+      m_p = lt;
+      return true;
+    }
+
+    if (m_end - m_p < 9 && m_more) {
+      // Too short to tell a comment or CDATA section from a tag.
+      if (memchr(m_p, '>', m_end - m_p) == nullptr) {
+        return stop(start);
+      }
+    }
+
+    if (starts_with(m_p, m_end, "<!--")) {
+      if (!skip_past("-->")) {
+        return stop(start);
+      }
+      continue;
+    } else if (starts_with(m_p, m_end, "<![CDATA[")) {
+      const char *data = m_p + 9;
+      m_p = data;
+      if (!skip_past("]]>")) {
+        return stop(start);
+      }
+      if (m_p - 3 == data) {
+        continue;
+      }
+      tok->type = kXmlTokenText;
+      tok->text = std::string_view(data, m_p - 3 - data);
+      return true;
+    } else if (starts_with(m_p, m_end, "<?")) {
+      if (!skip_past("?>")) {
+        return stop(start);
+      }
+      continue;
+    } else if (starts_with(m_p, m_end, "<!")) {
+      if (!skip_doctype()) {
+        return stop(start);
+      }
+      continue;
+    }
+
+    bool is_end = m_p + 1 < m_end && m_p[1] == '/';
+    const char *name = m_p + (is_end ? 2 : 1);
+    const char *p = name;
+    for (; p < m_end && !is_name_end(*p); ++p) {
+    }
+    const char *name_end = p;
+
+    // Attribute values may legally contain '>', so honour the quotes.
+    for (char quote = 0; p < m_end; ++p) {
+      if (quote != 0) {
+        quote = *p == quote ? 0 : quote;
+      } else if (*p == '"' || *p == '\'') {
+        quote = *p;
+      } else if (*p == '>') {
+        break;
+      }
+    }
+    if (p == m_end) {
+      return stop(start);
+    }
+
+    tok->type = is_end ? kXmlTokenEnd : kXmlTokenStart;
+    tok->name = std::string_view(name, name_end - name);
+    tok->self_closing = !is_end && p[-1] == '/' && p - 1 >= name_end;
+    tok->attrs = std::string_view(
+        name_end, (tok->self_closing ? p - 1 : p) - name_end);
+    tok->text = std::string_view();
+    m_p = p + 1;
+    return true;
+  }
+  m_need_more = m_more;
+  return false;
+}
+
+std::string_view XmlLocalName(std::string_view name) {
+  size_t pos = name.find(':');
+  return pos == std::string_view::npos ? name : name.substr(pos + 1);
+}
+
+bool XmlAttrValue(std::string_view attrs, std::string_view name,
+                  std::string_view *val) {
+  const char *p = attrs.data();
+  const char *end = p + attrs.size();
+  for (;;) {
+    for (; p < end && is_space(*p); ++p) {
+    }
+    const char *n = p;
+    for (; p < end && *p != '=' && !is_space(*p); ++p) {
+    }
+    const char *n_end = p;
+    for (; p < end && (*p == '=' || is_space(*p)); ++p) {
+    }
+    if (p >= end || (*p != '"' && *p != '\'') || n == n_end) {
+      return false;
+    }
+
+    const char *v = p + 1;
+    const char *v_end = static_cast<const char *>(memchr(v, *p, end - v));
+    if (v_end == nullptr) {
+      return false;
+    }
+    if (std::string_view(n, n_end - n) == name) {
+      *val = std::string_view(v, v_end - v);
+      return true;
+    }
+    p = v_end + 1;
+  }
+}
+
+}  // namespace officex
+
+}  // namespace msoffice
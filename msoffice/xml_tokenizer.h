@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <string_view>
+
+namespace msoffice {
+
+namespace officex {
+
+enum xml_token_type_t {
+  kXmlTokenStart = 1,
+  kXmlTokenEnd = 2,
+  kXmlTokenText = 3,
+};
+
+// All views point into the buffer given to the tokenizer. Text is returned
+// raw: entities are not expanded and a run of character data may arrive as
+// several text tokens (e.g. around comments or CDATA sections).
+struct xml_token_t {
+  xml_token_type_t type;
+  std::string_view name;   // qualified name of a start/end tag, e.g. "w:t"
+  std::string_view attrs;  // raw attribute list of a start tag
+  std::string_view text;   // character data of a text token
+  bool self_closing;       // start tag written as <name/>
+};
+
+// Single-pass pull tokenizer over a read-only XML buffer. Comments,
+// processing instructions and DOCTYPE are skipped; the content of CDATA
+// sections is returned as text.
+//
+// With `more` set the buffer is taken to be a prefix of the document: text
+// running into the end is returned up to the last whole UTF-8 character,
+// and a construct cut by the end stops the tokenizer with NeedMore() set and
+// Offset() at its first byte, so the caller can refill and resume there.
+class XmlTokenizer {
+ public:
+  XmlTokenizer(const char *s = nullptr, size_t len = 0, bool more = false);
+
+  // Returns false at the end of the input or at a tag that is not closed.
+  bool Next(xml_token_t *tok);
+
+  inline bool NeedMore() const {
+    return m_need_more;
+  }
+  inline size_t Offset() const {
+    return m_p - m_begin;
+  }
+
+ private:
+  bool skip_past(std::string_view end);
+  bool skip_doctype();
+  bool stop(const char *start);
+
+ private:
+  const char *m_begin;
+  const char *m_p;
+  const char *m_end;
+  bool m_more;
+  bool m_need_more;
+};
+
+// "w:t" -> "t", "t" -> "t".
+std::string_view XmlLocalName(std::string_view name);
+
+// Looks up attribute `name` (qualified, e.g. "r:id") in the attrs of a start
+// tag. The value is returned raw, without the quotes.
+bool XmlAttrValue(std::string_view attrs, std::string_view name,
+                  std::string_view *val);
+
+}  // namespace officex
+
+}  // namespace msoffice
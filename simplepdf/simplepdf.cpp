@@ -2,9 +2,11 @@
 
 #include <poppler/GlobalParams.h>
 #include <poppler/TextOutputDev.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include <memory>
+#include <mutex>
 
 #include "simplepdf/imgoutputdev.h"
 
@@ -20,9 +22,27 @@ namespace simplepdf {
 
 class _SimpleTextOutputDev : public TextOutputDev {
  public:
-  _SimpleTextOutputDev() : TextOutputDev(nullptr, false, 0, false, false) {}
+  explicit _SimpleTextOutputDev(size_t max_chars = SIZE_MAX)
+      : TextOutputDev(nullptr, false, 0, false, false),
+        m_max_chars(max_chars),
+        m_chars(0) {}
   virtual ~_SimpleTextOutputDev() {}
 
+  // Counts the characters handed to the text page, so that rendering can be
+  // stopped once the page has produced more than the caller wants.
+  void drawChar(GfxState *state, double x, double y, double dx, double dy,
+                double originX, double originY, CharCode c, int nBytes,
+                const Unicode *u, int uLen) override {
+    TextOutputDev::drawChar(state, x, y, dx, dy, originX, originY, c, nBytes,
+                            u, uLen);
+    m_chars += uLen;
+  }
+
+  static bool AbortCheck(void *data) {
+    auto out = static_cast<_SimpleTextOutputDev *>(data);
+    return out->m_chars >= out->m_max_chars;
+  }
+
   bool radialShadedFill(GfxState * /*state*/, GfxRadialShading * /*shading*/,
                         double /*sMin*/, double /*sMax*/) override {
     return true;
@@ -34,11 +54,18 @@ class _SimpleTextOutputDev : public TextOutputDev {
   // void drawImage(GfxState *state, Object *ref, Stream *str, int width,
   //                int height, GfxImageColorMap *colorMap, bool interpolate,
   //                const int *maskColors, bool inlineImg) override {}
+
+ private:
+  size_t m_max_chars;
+  size_t m_chars;
 };
 
 void Init(const char *poppler_data_dir) {
-  globalParams =
-      std::unique_ptr<GlobalParams>(new GlobalParams(poppler_data_dir));
+  static std::once_flag once;
+  std::call_once(once, [poppler_data_dir]() {
+    globalParams =
+        std::unique_ptr<GlobalParams>(new GlobalParams(poppler_data_dir));
+  });
 }
 
 SimplePDF::SimplePDF(const char *buf, size_t buf_len) : m_doc(nullptr) {
@@ -71,7 +98,7 @@ void SimplePDF::Debug() {
   }
 }
 
-std::unique_ptr<GooString> SimplePDF::PageText(int n) {
+std::unique_ptr<GooString> SimplePDF::PageText(int n, size_t max_chars) {
   if (n < 1 || n > PagesCnt()) {
     return nullptr;
   }
@@ -81,8 +108,9 @@ std::unique_ptr<GooString> SimplePDF::PageText(int n) {
     return nullptr;
   }
 
-  _SimpleTextOutputDev out;
-  page->displaySlice(&out, 72, 72, 0, false, false, -1, -1, -1, -1, false);
+  _SimpleTextOutputDev out(max_chars);
+  page->displaySlice(&out, 72, 72, 0, false, false, -1, -1, -1, -1, false,
+                     _SimpleTextOutputDev::AbortCheck, &out);
   double w = page->getMediaWidth();
   double h = page->getMediaHeight();
   GooString *text = out.getText(0, 0, w, h);
@@ -2,11 +2,14 @@
 
 #include <poppler/GlobalParams.h>
 #include <poppler/PDFDoc.h>
+#include <stdint.h>
 
 #include <memory>
 
 namespace simplepdf {
 
+// Sets up poppler's globalParams. Safe to call from several threads; only the
+// first call has any effect.
 void Init(const char *poppler_data_dir = nullptr);
 
 class SimplePDF {
@@ -16,7 +19,10 @@ class SimplePDF {
 
   bool IsOK() const;
   int PagesCnt() const;
-  std::unique_ptr<GooString> PageText(int n);
+  // Rendering of the page stops soon after it has produced max_chars
+  // characters, so the text returned may be cut short (or run a little past
+  // max_chars); callers still need to truncate it themselves.
+  std::unique_ptr<GooString> PageText(int n, size_t max_chars = SIZE_MAX);
 
   void Debug();
 
@@ -0,0 +1,234 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <codecvt>
+#include <functional>
+#include <limits>
+#include <locale>
+#include <string>
+#include <vector>
+
+#include "msoffice/ms_xls/ms_xls.h"
+#include "msoffice/officex.h"
+#include "msoffice/utils.h"
+#include "msoffice/xml_tokenizer.h"
+#include "tests/samples.h"
+#include "utils/utils.h"
+
+// Throughput of the hot paths on synthetic input. `bench [name]` runs only
+// the benchmarks whose name contains `name`.
+
+static const char *g_filter = nullptr;
+static volatile size_t g_sink;
+
+// Calls fn until half a second has passed and prints the rate at which it
+// got through `bytes` bytes per call.
+static bool selected(const std::string &name) {
+  return g_filter == nullptr || name.find(g_filter) != std::string::npos;
+}
+
+static void run(const std::string &name, size_t bytes,
+                const std::function<size_t()> &fn) {
+  if (!selected(name)) {
+    return;
+  }
+  using clock = std::chrono::steady_clock;
+  g_sink = fn();
+  size_t iters = 0;
+  auto start = clock::now();
+  std::chrono::duration<double> elapsed{};
+  while (elapsed.count() < 0.5) {
+    g_sink = g_sink + fn();
+    iters += 1;
+    elapsed = clock::now() - start;
+  }
+  double secs = elapsed.count() / iters;
+  printf("%-36s %10.1f MB/s %12.3f ms\n", name.c_str(),
+         bytes / secs / (1 << 20), secs * 1000);
+}
+
+// =============================================================================
+
+static void bench_utf8() {
+  std::string ascii, mixed;
+  const char mix[] = "text \xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80 ";
+  while (mixed.size() < (1 << 20)) {
+    ascii.append("plain ascii text ");
+    mixed.append(mix);
+  }
+
+  for (auto &kernel : utils::utf8_kernels_available()) {
+    for (auto *input : {&ascii, &mixed}) {
+      std::string what = input == &ascii ? "ascii" : "mixed";
+      const char *s = input->data();
+      size_t len = input->size();
+      run(std::string("utf8 count ") + kernel.name + " " + what, len,
+          [&]() { return kernel.count(s, len); });
+      run(std::string("utf8 fix ") + kernel.name + " " + what, len,
+          [&]() { return kernel.fix(s, len, len); });
+    }
+  }
+}
+
+// =============================================================================
+
+// The strstr-based scan that the tokenizer replaced, kept to compare with:
+// every <w:t ...>...</w:t> pair is found by searching from the last one.
+static bool legacy_find_tag(const char *s, const char *name, const char **out,
+                            size_t *out_len) {
+  for (const char *left = s; *left != '\0'; ++left) {
+    left = strstr(left, name);
+    if (left == nullptr) {
+      return false;
+    }
+    const char *right = left + strlen(name);
+    if (*right == '\0') {
+      return false;
+    } else if (!(*right == ' ' || *right == '\t' || *right == '\n' ||
+                 *right == '\r' || *right == '>' || *right == '/')) {
+      continue;
+    }
+    if ((right = strchr(right, '>')) == nullptr) {
+      return false;
+    }
+    *out = left;
+    *out_len = right - left + 1;
+    return true;
+  }
+  return false;
+}
+
+static size_t legacy_docx_text(const char *xml, std::string *text) {
+  const char *ll = nullptr;
+  size_t llen = 0;
+  for (bool f = legacy_find_tag(xml, "<w:t", &ll, &llen); f;
+       f = legacy_find_tag(ll + llen, "<w:t", &ll, &llen)) {
+    const char *lr = ll + llen;
+    const char *rl = nullptr;
+    size_t rlen = 0;
+    if (!legacy_find_tag(lr, "</w:t", &rl, &rlen)) {
+      break;
+    }
+    text->append(lr, rl - lr);
+    text->push_back('\n');
+  }
+  return text->size();
+}
+
+static void bench_xml() {
+  std::string xml = samples::MakeDocxDocument(1, 20000);
+  std::string text;
+
+  run("xml tokenizer tokens", xml.size(), [&]() {
+    msoffice::officex::XmlTokenizer tz(xml.data(), xml.size());
+    msoffice::officex::xml_token_t tok;
+    size_t n = 0;
+    while (tz.Next(&tok)) {
+      n += 1;
+    }
+    return n;
+  });
+  run("xml docx text tokenizer", xml.size(), [&]() {
+    msoffice::fetch_text_options_t opts;
+    text.clear();
+    msoffice::officex::MsDOCxFetchText(xml.data(), xml.size(), &opts, &text);
+    return text.size();
+  });
+  run("xml docx text find_tag", xml.size(), [&]() {
+    text.clear();
+    return legacy_docx_text(xml.c_str(), &text);
+  });
+}
+
+// =============================================================================
+
+static void bench_utf16() {
+  const std::u16string words[] = {u"plain ascii text ", u"Ünïcødé ",
+                                  u"中文日本語 ", u"\U0001F600 "};
+  std::u16string ascii, mixed;
+  for (size_t i = 0; mixed.size() < (1 << 19); ++i) {
+    ascii.append(words[0]);
+    mixed.append(words[i % 4]);
+  }
+
+  std::string u8;
+  for (auto *input : {&ascii, &mixed}) {
+    std::string what = input == &ascii ? " ascii" : " mixed";
+    const char16_t *begin = input->data();
+    const char16_t *end = begin + input->size();
+    size_t bytes = input->size() * 2;
+    run("utf16 AppendUtf16ToUtf8" + what, bytes, [&]() {
+      u8.clear();
+      msoffice::AppendUtf16ToUtf8(begin, end, &u8);
+      return u8.size();
+    });
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+    run("utf16 wstring_convert" + what, bytes, [&]() {
+      std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> conv;
+      return conv.to_bytes(begin, end).size();
+    });
+#pragma GCC diagnostic pop
+  }
+}
+
+// =============================================================================
+
+// One million cells, a quarter of them shared strings, converted end to end
+// with eager and lazy shared strings. Rates are in MB of file read.
+static void bench_sheets() {
+  if (!selected("sheet xlsx 1M cells lazy sst") &&
+      !selected("sheet xls 1M cells lazy sst")) {
+    return;
+  }
+  std::string path = (std::filesystem::temp_directory_path() /
+                      ("bench_" + std::to_string(getpid()) + ".xlsx"))
+                         .string();
+  std::string xlsx;
+  if (samples::WriteXlsx(path, 1, 1, 250000) != 0 ||
+      utils::read_file(path.c_str(), &xlsx) != 0) {
+    fprintf(stderr, "bench: cannot write %s\n", path.c_str());
+    return;
+  }
+  std::filesystem::remove(path);
+  std::string xls = samples::MakeXls(1, 4, 62500);
+
+  std::string text;
+  for (bool lazy : {false, true}) {
+    msoffice::fetch_text_options_t opts;
+    opts.xls_max_sst_cnt = 0;
+    opts.lazy_sst = lazy;
+    opts.lazy_sst_max_part_len = std::numeric_limits<size_t>::max();
+    std::string what = lazy ? " lazy sst" : "";
+    run("sheet xlsx 1M cells" + what, xlsx.size(), [&]() {
+      msoffice::officex::ZipHelper zip;
+      text.clear();
+      if (zip.OpenFromBytes(xlsx.data(), xlsx.size()) == 0) {
+        msoffice::officex::MsXLSxFetchText(zip, &opts, &text);
+      }
+      return text.size();
+    });
+    run("sheet xls 1M cells" + what, xls.size(), [&]() {
+      msoffice::xls::MsXLS doc;
+      text.clear();
+      if (doc.ParseFromSpan(xls) == 0) {
+        doc.FetchText(&opts, &text);
+      }
+      return text.size();
+    });
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    g_filter = argv[1];
+  }
+  bench_utf8();
+  bench_xml();
+  bench_utf16();
+  bench_sheets();
+  return 0;
+}
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "msoffice/compound_document.h"
+#include "tests/samples.h"
+
+static int g_failures = 0;
+
+#define CHECK(_cond)                                                 \
+  do {                                                               \
+    if (!(_cond)) {                                                  \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+              #_cond);                                               \
+      g_failures += 1;                                               \
+    }                                                                \
+  } while (0)
+
+static std::string stream_bytes(const samples::cfb_stream_t &s) {
+  std::string out(std::max<uint64_t>(s.size, s.data.size()), '\0');
+  memcpy(out.data(), s.data.data(), s.data.size());
+  memcpy(out.data() + out.size() - s.tail.size(), s.tail.data(),
+         s.tail.size());
+  return out;
+}
+
+// Streams on both sides of the 4096-byte mini stream cutoff, with names
+// that differ in length and case so the directory tree has some shape.
+static std::vector<samples::cfb_stream_t> make_streams(uint32_t seed,
+                                                       size_t n) {
+  std::mt19937 rng(seed);
+  std::vector<samples::cfb_stream_t> streams(n);
+  for (size_t i = 0; i < n; ++i) {
+    std::string name = (i % 2 ? "s" : "Stream") + std::to_string(i);
+    streams[i].name.assign(name.begin(), name.end());
+    size_t size = i % 3 == 0 ? 1 + rng() % 4095 : 4096 + rng() % 40000;
+    for (size_t k = 0; k < size; ++k) {
+      streams[i].data.push_back(static_cast<char>(rng()));
+    }
+  }
+  return streams;
+}
+
+static void check_streams(const msoffice::CompoundDocument &doc,
+                          const std::vector<samples::cfb_stream_t> &streams) {
+  auto &dirs = doc.GetDirEntries();
+  for (auto &s : streams) {
+    int idx = doc.FindDirEntry(s.name);
+    CHECK(idx > 0);
+    if (idx <= 0) {
+      continue;
+    }
+    std::string expected = stream_bytes(s);
+    msoffice::StreamView view;
+    CHECK(doc.GetDirEntryStreamView(dirs[idx], &view) == 0);
+    CHECK(view.Size() == expected.size());
+
+    std::vector<char> bytes;
+    CHECK(view.ReadAll(&bytes) == 0);
+    CHECK(std::string(bytes.begin(), bytes.end()) == expected);
+    CHECK(doc.GetDirEntryStream(dirs[idx], &bytes) == 0);
+    CHECK(std::string(bytes.begin(), bytes.end()) == expected);
+  }
+}
+
+// v3 and v4 sectors, the odd 128/256-byte sectors that still follow a
+// 512-byte header, and chains in file order or shuffled.
+static void test_layouts() {
+  auto streams = make_streams(1, 12);
+  struct {
+    int version;
+    int sector_shift;
+  } layouts[] = {{3, 0}, {4, 0}, {3, 7}, {3, 8}};
+  for (auto &layout : layouts) {
+    for (bool scatter : {false, true}) {
+      samples::cfb_opts_t opts;
+      opts.version = layout.version;
+      opts.sector_shift = layout.sector_shift;
+      opts.scatter = scatter;
+      std::string file = samples::MakeCfb(streams, opts);
+      CHECK(!file.empty());
+
+      msoffice::CompoundDocument doc;
+      CHECK(doc.ParseFromBytes(file.data(), file.size()) == 0);
+      check_streams(doc, streams);
+    }
+  }
+}
+
+// More SAT sectors than the 109 the header lists: two MSAT sectors.
+static void test_msat_chain() {
+  auto streams = make_streams(2, 6);
+  samples::cfb_opts_t opts;
+  opts.scatter = true;
+  opts.pad_sectors = 40000;
+  std::string file = samples::MakeCfb(streams, opts);
+
+  msoffice::CompoundDocument doc;
+  CHECK(doc.ParseFromBytes(file.data(), file.size()) == 0);
+  auto hdr = doc.GetHeader();
+  CHECK(hdr->total_number_of_sect_used_for_master_sect_alloc_table == 2);
+  CHECK(doc.GetMSAT().size() ==
+        hdr->total_number_of_sect_used_for_sect_alloc_table);
+  CHECK(doc.GetMSAT().size() > 109 + 127);
+  check_streams(doc, streams);
+}
+
+// A root whose tree is not sorted, so lookups fall back to visiting its
+// siblings, and a storage nested in it that holds a stream of the same name.
+// The nested stream comes first in the directory and must not be found from
+// the root.
+static void test_unsorted_tree() {
+  std::vector<samples::cfb_stream_t> streams(4);
+  streams[0].name = u"WordDocument";
+  streams[0].data = "inner";
+  streams[1].name = u"ObjectPool";
+  streams[1].data = "storage";
+  streams[2].name = u"WordDocument";
+  streams[2].data = "outer";
+  streams[3].name = u"Zz";
+  streams[3].data = "zz";
+  std::string file = samples::MakeCfb(streams, samples::cfb_opts_t());
+
+  // Relink the directory in place: ids 1-4 are the streams in order.
+  msoffice::CompoundDocument doc;
+  CHECK(doc.ParseFromBytes(file.data(), file.size()) == 0);
+  auto dirs = doc.GetDirEntries();
+  size_t dir_len = dirs.size() * sizeof(msoffice::directory_entry_t);
+  auto dir_pos = file.find(std::string(
+      reinterpret_cast<const char *>(dirs.data()), dir_len));
+  CHECK(dirs.size() >= 5 && dir_pos != std::string::npos);
+  if (dirs.size() < 5 || dir_pos == std::string::npos) {
+    return;
+  }
+  for (auto &dir : dirs) {
+    dir.left_child_dir_id = -1;
+    dir.right_child_dir_id = -1;
+    dir.root_dir_id = -1;
+  }
+  dirs[0].root_dir_id = 2;
+  dirs[2].type = msoffice::kDirEntryTypeUserStorage;
+  dirs[2].size_of_x = 0;
+  dirs[2].root_dir_id = 1;
+  dirs[2].left_child_dir_id = 3;  // belongs on the right
+  dirs[2].right_child_dir_id = 4;
+
+  auto parse = [&](msoffice::CompoundDocument *out) {
+    memcpy(file.data() + dir_pos, dirs.data(), dir_len);
+    return out->ParseFromBytes(file.data(), file.size());
+  };
+  msoffice::CompoundDocument unsorted;
+  CHECK(parse(&unsorted) == 0);
+  CHECK(unsorted.FindDirEntry(u"WordDocument") == 3);
+  CHECK(unsorted.FindDirEntry(u"wordDOCUMENT") == 3);
+  CHECK(unsorted.FindDirEntry(u"ObjectPool/WordDocument") == 1);
+  CHECK(unsorted.FindDirEntry(u"Zz") == 4);
+
+  // Only the nested stream is left.
+  dirs[2].left_child_dir_id = -1;
+  msoffice::CompoundDocument nested_only;
+  CHECK(parse(&nested_only) == 0);
+  CHECK(nested_only.FindDirEntry(u"WordDocument") < 0);
+  CHECK(nested_only.FindDirEntry(u"ObjectPool/WordDocument") == 1);
+}
+
+// A v4 stream past 2 GB, written sparse: only its first and last bytes and
+// the allocation tables take up disk space.
+static void test_large_stream() {
+  const uint64_t size = (1ull << 31) + 3 * 4096 + 123;
+  std::mt19937 rng(3);
+  std::vector<samples::cfb_stream_t> streams(2);
+  streams[0].name = u"Big";
+  streams[0].size = size;
+  streams[0].data = "HEAD";
+  streams[0].tail = "TAIL";
+  for (int i = 0; i < 9000; ++i) {
+    streams[0].data.push_back(static_cast<char>(rng()));
+    streams[0].tail.insert(streams[0].tail.begin(), static_cast<char>(rng()));
+  }
+  streams[1].name = u"Small";
+  streams[1].data = "small stream";
+
+  samples::cfb_opts_t opts;
+  opts.version = 4;
+  std::string path = (std::filesystem::temp_directory_path() /
+                      ("cfb_test_" + std::to_string(getpid()) + ".cfb"))
+                         .string();
+  CHECK(samples::WriteCfbFile(path, streams, opts) == 0);
+
+  msoffice::CompoundDocument doc;
+  CHECK(doc.ParseFromFile(path) == 0);
+  CHECK(doc.GetHeader()
+            ->total_number_of_sect_used_for_master_sect_alloc_table == 1);
+  check_streams(doc, {streams[1]});
+
+  int idx = doc.FindDirEntry(u"Big");
+  CHECK(idx > 0);
+  if (idx > 0) {
+    auto &dir = doc.GetDirEntries()[idx];
+    CHECK(doc.GetDirEntryStreamSize(dir) == size);
+
+    msoffice::StreamView view;
+    CHECK(doc.GetDirEntryStreamView(dir, &view) == 0);
+    CHECK(view.Size() == size);
+
+    auto &head = streams[0].data;
+    auto &tail = streams[0].tail;
+    std::vector<char> buf(std::max(head.size(), tail.size()));
+    CHECK(view.Read(0, head.size(), buf.data()) == 0);
+    CHECK(memcmp(buf.data(), head.data(), head.size()) == 0);
+    CHECK(view.Read(size - tail.size(), tail.size(), buf.data()) == 0);
+    CHECK(memcmp(buf.data(), tail.data(), tail.size()) == 0);
+    CHECK(view.Read(1ull << 31, 16, buf.data()) == 0);
+    CHECK(std::all_of(buf.begin(), buf.begin() + 16,
+                      [](char c) { return c == 0; }));
+    CHECK(view.Read(size - 1, 2, buf.data()) != 0);
+
+    msoffice::StreamView head_view;
+    CHECK(doc.GetDirEntryStreamView(dir, head.size(), &head_view) == 0);
+    CHECK(head_view.Size() >= head.size() && head_view.Size() < size);
+  }
+  std::filesystem::remove(path);
+}
+
+int main() {
+  test_layouts();
+  test_msat_chain();
+  test_unsorted_tree();
+  test_large_stream();
+  if (g_failures > 0) {
+    fprintf(stderr, "cfb_test: %d failures\n", g_failures);
+    return 1;
+  }
+  printf("cfb_test: ok\n");
+  return 0;
+}
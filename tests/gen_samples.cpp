@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <filesystem>
+#include <string>
+
+#include "tests/samples.h"
+
+// Writes COUNT samples of every supported format into DIR, alternating
+// compound file versions and sector layouts.
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <dir> [count]\n", argv[0]);
+    return 2;
+  }
+  std::string dir = argv[1];
+  int cnt = argc > 2 ? atoi(argv[2]) : 4;
+  std::error_code ec;
+  std::filesystem::create_directories(dir, ec);
+  if (ec) {
+    fprintf(stderr, "%s: %s\n", dir.c_str(), ec.message().c_str());
+    return 1;
+  }
+
+  for (int i = 0; i < cnt; ++i) {
+    uint32_t seed = i + 1;
+    samples::cfb_opts_t opts;
+    opts.version = i % 2 == 0 ? 3 : 4;
+    opts.scatter = i % 3 != 0;
+    opts.seed = seed;
+
+    char name[32];
+    snprintf(name, sizeof(name), "/sample-%03d", i);
+    std::string base = dir + name;
+    size_t scale = 1 + i % 4;
+    if (samples::WriteFile(base + ".doc",
+                           samples::MakeDoc(seed, 200 * scale, opts)) != 0 ||
+        samples::WriteFile(base + ".xls",
+                           samples::MakeXls(seed, 2 + i % 3, 500 * scale,
+                                            opts)) != 0 ||
+        samples::WriteFile(base + ".ppt",
+                           samples::MakePpt(seed, 10 * scale, opts)) != 0 ||
+        samples::WriteFile(base + ".pdf",
+                           samples::MakePdf(seed, 4 * scale)) != 0 ||
+        samples::WriteDocx(base + ".docx", seed, 200 * scale) != 0 ||
+        samples::WriteXlsx(base + ".xlsx", seed, 2 + i % 3, 500 * scale) !=
+            0 ||
+        samples::WritePptx(base + ".pptx", seed, 10 * scale) != 0) {
+      fprintf(stderr, "%s: failed to write samples\n", base.c_str());
+      return 1;
+    }
+  }
+  return 0;
+}
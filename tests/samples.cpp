@@ -0,0 +1,874 @@
+#include "tests/samples.h"
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <zip.h>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+#include "msoffice/compound_document.h"
+#include "msoffice/ms_doc.h"
+#include "msoffice/ms_ppt.h"
+
+namespace samples {
+
+using msoffice::compound_doc_header_t;
+using msoffice::directory_entry_t;
+
+static const char *const kWords[] = {
+    "alpha", "beta",   "gamma",   "delta",  "report", "quarterly",
+    "R&D",   "<tag>",  "revenue", "margin", "north",  "south",
+    "index", "growth", "plan",    "draft",  "final",  "review",
+};
+
+static const char *const kWideWords[] = {
+    "中文", "日本語", "Ünïcødé", "Ελληνικά", "кириллица", "한국어",
+};
+
+static std::string random_words(std::mt19937 *rng, size_t n, bool wide) {
+  std::string s;
+  for (size_t i = 0; i < n; ++i) {
+    if (!s.empty()) {
+      s.push_back(' ');
+    }
+    if (wide && (*rng)() % 4 == 0) {
+      s.append(kWideWords[(*rng)() % std::size(kWideWords)]);
+    } else {
+      s.append(kWords[(*rng)() % std::size(kWords)]);
+    }
+  }
+  return s;
+}
+
+// BMP only, which is all the generators produce.
+static std::u16string utf8_to_utf16(const std::string &s) {
+  std::u16string out;
+  for (size_t i = 0; i < s.size();) {
+    auto c = static_cast<uint8_t>(s[i]);
+    if (c < 0x80) {
+      out.push_back(c);
+      i += 1;
+    } else if (c < 0xe0) {
+      out.push_back(((c & 0x1f) << 6) | (s[i + 1] & 0x3f));
+      i += 2;
+    } else {
+      out.push_back(((c & 0x0f) << 12) | ((s[i + 1] & 0x3f) << 6) |
+                    (s[i + 2] & 0x3f));
+      i += 3;
+    }
+  }
+  return out;
+}
+
+static std::string xml_escape(const std::string &s) {
+  std::string out;
+  for (char c : s) {
+    if (c == '&') {
+      out.append("&amp;");
+    } else if (c == '<') {
+      out.append("&lt;");
+    } else if (c == '>') {
+      out.append("&gt;");
+    } else {
+      out.push_back(c);
+    }
+  }
+  return out;
+}
+
+template <typename T>
+static void put(std::string *out, T v) {
+  out->append(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+static void put_u16(std::string *out, const std::u16string &s) {
+  out->append(reinterpret_cast<const char *>(s.data()), s.size() * 2);
+}
+
+int WriteFile(const std::string &path, const std::string &data) {
+  FILE *fp = fopen(path.c_str(), "wb");
+  if (fp == nullptr) {
+    return -1;
+  }
+  size_t n = fwrite(data.data(), 1, data.size(), fp);
+  return fclose(fp) == 0 && n == data.size() ? 0 : -1;
+}
+
+// =============================================================================
+
+// Directory order: shorter names first, then by upper-cased code units.
+static bool dir_name_less(const std::u16string &a, const std::u16string &b) {
+  if (a.size() != b.size()) {
+    return a.size() < b.size();
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    char16_t x = a[i] >= u'a' && a[i] <= u'z' ? a[i] - 0x20 : a[i];
+    char16_t y = b[i] >= u'a' && b[i] <= u'z' ? b[i] - 0x20 : b[i];
+    if (x != y) {
+      return x < y;
+    }
+  }
+  return false;
+}
+
+static void set_dir_entry(directory_entry_t *e, const std::u16string &name,
+                          uint8_t type, int32_t first_sec_id, uint64_t size,
+                          int version) {
+  memcpy(e->unicode_name, name.data(), name.size() * 2);
+  e->name_len = (name.size() + 1) * 2;
+  e->type = type;
+  e->color = msoffice::kDirEntryColorBlack;
+  e->sec_id_of_1st_x = first_sec_id;
+  e->size_of_x = static_cast<uint32_t>(size);
+  e->size_of_x_high = version >= 4 ? static_cast<uint32_t>(size >> 32) : 0;
+}
+
+int WriteCfb(const std::vector<cfb_stream_t> &streams, const cfb_opts_t &opts,
+             uint64_t *size, const write_fn_t &write) {
+  const int ssz =
+      opts.sector_shift > 0 ? opts.sector_shift : opts.version >= 4 ? 12 : 9;
+  const size_t sec_size = 1ul << ssz;
+  const uint64_t hdr_size = std::max<uint64_t>(512, sec_size);
+  const size_t ids_per_sec = sec_size / sizeof(int32_t);
+  const uint64_t min_size_of_std_stream = 4096;
+  const size_t n = streams.size();
+
+  std::vector<uint64_t> sizes(n);
+  for (size_t i = 0; i < n; ++i) {
+    sizes[i] = std::max<uint64_t>(streams[i].size, streams[i].data.size());
+    if (sizes[i] == 0 ||
+        sizes[i] < streams[i].data.size() + streams[i].tail.size()) {
+      return -1;
+    }
+  }
+
+  // Short streams live in the mini stream, 64 bytes a sector.
+  std::string mini;
+  std::vector<int32_t> ssat;
+  std::vector<int32_t> first(n, msoffice::kEndOfChainSecID);
+  for (size_t i = 0; i < n; ++i) {
+    if (sizes[i] >= min_size_of_std_stream) {
+      continue;
+    }
+    std::string bytes(sizes[i], '\0');
+    memcpy(bytes.data(), streams[i].data.data(), streams[i].data.size());
+    memcpy(bytes.data() + sizes[i] - streams[i].tail.size(),
+           streams[i].tail.data(), streams[i].tail.size());
+
+    size_t cnt = (bytes.size() + 63) / 64;
+    first[i] = ssat.size();
+    for (size_t k = 0; k < cnt; ++k) {
+      ssat.push_back(k + 1 < cnt ? first[i] + k + 1
+                                 : msoffice::kEndOfChainSecID);
+    }
+    mini.append(bytes);
+    mini.resize(ssat.size() * 64, '\0');
+  }
+  ssat.resize((ssat.size() + ids_per_sec - 1) / ids_per_sec * ids_per_sec,
+              msoffice::kFreeSecID);
+
+  auto sec_cnt = [sec_size](uint64_t len) {
+    return static_cast<size_t>((len + sec_size - 1) / sec_size);
+  };
+  const size_t dir_per_sec = sec_size / sizeof(directory_entry_t);
+  const size_t dir_sec_cnt = (n + 1 + dir_per_sec - 1) / dir_per_sec;
+  size_t data_cnt = sec_cnt(mini.size()) + sec_cnt(ssat.size() * 4) +
+                    dir_sec_cnt + opts.pad_sectors;
+  for (size_t i = 0; i < n; ++i) {
+    if (sizes[i] >= min_size_of_std_stream) {
+      data_cnt += sec_cnt(sizes[i]);
+    }
+  }
+
+  // The SAT and MSAT sectors are allocated in the SAT as well.
+  size_t sat_cnt = 1;
+  size_t msat_cnt = 0;
+  for (;;) {
+    msat_cnt = sat_cnt > 109 ? (sat_cnt - 109 + ids_per_sec - 2) /
+                                   (ids_per_sec - 1)
+                             : 0;
+    size_t need =
+        (data_cnt + sat_cnt + msat_cnt + ids_per_sec - 1) / ids_per_sec;
+    if (need <= sat_cnt) {
+      break;
+    }
+    sat_cnt = need;
+  }
+  const size_t total = data_cnt + sat_cnt + msat_cnt;
+
+  std::vector<int32_t> order(total);
+  std::iota(order.begin(), order.end(), 0);
+  if (opts.scatter) {
+    std::shuffle(order.begin(), order.end(), std::mt19937(opts.seed));
+  }
+
+  std::vector<int32_t> sat(sat_cnt * ids_per_sec, msoffice::kFreeSecID);
+  size_t next = 0;
+  auto take = [&](size_t cnt, int32_t mark) {
+    std::vector<int32_t> ids(order.begin() + next,
+                             order.begin() + next + cnt);
+    next += cnt;
+    for (size_t k = 0; k < cnt; ++k) {
+      if (mark != msoffice::kEndOfChainSecID) {
+        sat[ids[k]] = mark;
+      } else {
+        sat[ids[k]] = k + 1 < cnt ? ids[k + 1] : msoffice::kEndOfChainSecID;
+      }
+    }
+    return ids;
+  };
+
+  auto sect_pos = [ssz, hdr_size](int32_t id) {
+    return hdr_size + (static_cast<uint64_t>(id) << ssz);
+  };
+  auto write_chain = [&](const std::vector<int32_t> &ids, uint64_t offset,
+                         const char *p, size_t len) {
+    while (len > 0) {
+      size_t k = offset / sec_size;
+      size_t in_sec = offset % sec_size;
+      size_t chunk = std::min(len, sec_size - in_sec);
+      if (write(sect_pos(ids[k]) + in_sec, p, chunk) != 0) {
+        return -1;
+      }
+      offset += chunk;
+      p += chunk;
+      len -= chunk;
+    }
+    return 0;
+  };
+
+  *size = sect_pos(total);
+
+  std::vector<std::vector<int32_t>> chains(n);
+  for (size_t i = 0; i < n; ++i) {
+    if (sizes[i] < min_size_of_std_stream) {
+      continue;
+    }
+    chains[i] = take(sec_cnt(sizes[i]), msoffice::kEndOfChainSecID);
+    first[i] = chains[i][0];
+    auto &s = streams[i];
+    if (write_chain(chains[i], 0, s.data.data(), s.data.size()) != 0 ||
+        write_chain(chains[i], sizes[i] - s.tail.size(), s.tail.data(),
+                    s.tail.size()) != 0) {
+      return -1;
+    }
+  }
+
+  auto mini_ids = take(sec_cnt(mini.size()), msoffice::kEndOfChainSecID);
+  auto ssat_ids = take(sec_cnt(ssat.size() * 4), msoffice::kEndOfChainSecID);
+  auto dir_ids = take(dir_sec_cnt, msoffice::kEndOfChainSecID);
+  take(opts.pad_sectors, msoffice::kFreeSecID);
+  auto sat_ids = take(sat_cnt, msoffice::kSatSecID);
+  auto msat_ids = take(msat_cnt, msoffice::kMsatSecID);
+
+  if (write_chain(mini_ids, 0, mini.data(), mini.size()) != 0 ||
+      write_chain(ssat_ids, 0, reinterpret_cast<const char *>(ssat.data()),
+                  ssat.size() * 4) != 0) {
+    return -1;
+  }
+
+  // All streams hang off the root in a balanced tree, all nodes black.
+  std::vector<directory_entry_t> dirs(dir_sec_cnt * dir_per_sec);
+  memset(dirs.data(), 0, dirs.size() * sizeof(directory_entry_t));
+  for (auto &e : dirs) {
+    e.left_child_dir_id = -1;
+    e.right_child_dir_id = -1;
+    e.root_dir_id = -1;
+  }
+  std::vector<size_t> sorted(n);
+  std::iota(sorted.begin(), sorted.end(), 0);
+  std::sort(sorted.begin(), sorted.end(), [&](size_t a, size_t b) {
+    return dir_name_less(streams[a].name, streams[b].name);
+  });
+  std::function<int32_t(size_t, size_t)> build = [&](size_t lo, size_t hi) {
+    if (lo >= hi) {
+      return -1;
+    }
+    size_t mid = (lo + hi) / 2;
+    int32_t id = sorted[mid] + 1;
+    dirs[id].left_child_dir_id = build(lo, mid);
+    dirs[id].right_child_dir_id = build(mid + 1, hi);
+    return id;
+  };
+  set_dir_entry(&dirs[0], u"Root Entry", msoffice::kDirEntryTypeRootStorage,
+                mini.empty() ? msoffice::kEndOfChainSecID : mini_ids[0],
+                mini.size(), opts.version);
+  dirs[0].root_dir_id = build(0, n);
+  for (size_t i = 0; i < n; ++i) {
+    set_dir_entry(&dirs[i + 1], streams[i].name,
+                  msoffice::kDirEntryTypeUserStream, first[i], sizes[i],
+                  opts.version);
+  }
+  if (write_chain(dir_ids, 0, reinterpret_cast<const char *>(dirs.data()),
+                  dirs.size() * sizeof(directory_entry_t)) != 0) {
+    return -1;
+  }
+
+  for (size_t k = 0; k < sat_cnt; ++k) {
+    if (write(sect_pos(sat_ids[k]),
+              reinterpret_cast<const char *>(sat.data() + k * ids_per_sec),
+              sec_size) != 0) {
+      return -1;
+    }
+  }
+
+  // Each MSAT sector lists ids_per_sec - 1 SAT sectors and links to the next.
+  for (size_t k = 0; k < msat_cnt; ++k) {
+    std::vector<int32_t> ids(ids_per_sec, msoffice::kFreeSecID);
+    for (size_t j = 0; j + 1 < ids_per_sec; ++j) {
+      size_t s = 109 + k * (ids_per_sec - 1) + j;
+      if (s < sat_cnt) {
+        ids[j] = sat_ids[s];
+      }
+    }
+    ids.back() =
+        k + 1 < msat_cnt ? msat_ids[k + 1] : msoffice::kEndOfChainSecID;
+    if (write(sect_pos(msat_ids[k]), reinterpret_cast<const char *>(ids.data()),
+              sec_size) != 0) {
+      return -1;
+    }
+  }
+
+  compound_doc_header_t hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.doc_id = 0xE11AB1A1E011CFD0;
+  hdr.revision = 0x3E;
+  hdr.version = opts.version >= 4 ? 4 : 3;
+  hdr.byte_order = 0xFFFE;
+  hdr.ssz = ssz;
+  hdr.sssz = 6;
+  if (opts.version >= 4) {
+    uint32_t cnt = dir_sec_cnt;
+    memcpy(hdr.not_used0 + 6, &cnt, sizeof(cnt));
+  }
+  hdr.total_number_of_sect_used_for_sect_alloc_table = sat_cnt;
+  hdr.sec_id_of_1st_sect_of_dir_stream = dir_ids[0];
+  hdr.min_size_of_std_stream = min_size_of_std_stream;
+  hdr.sec_id_of_1st_sect_of_ss_alloc_table =
+      ssat_ids.empty() ? msoffice::kEndOfChainSecID : ssat_ids[0];
+  hdr.total_number_of_sect_used_for_ss_alloc_table = ssat_ids.size();
+  hdr.sec_id_of_1st_sect_of_master_sect_alloc_table =
+      msat_ids.empty() ? msoffice::kEndOfChainSecID : msat_ids[0];
+  hdr.total_number_of_sect_used_for_master_sect_alloc_table = msat_cnt;
+  for (size_t i = 0; i < 109; ++i) {
+    hdr.sec_ids[i] = i < sat_cnt ? sat_ids[i] : msoffice::kFreeSecID;
+  }
+  return write(0, reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+}
+
+std::string MakeCfb(const std::vector<cfb_stream_t> &streams,
+                    const cfb_opts_t &opts) {
+  std::string out;
+  uint64_t size = 0;
+  auto write = [&out](uint64_t offset, const char *p, size_t len) {
+    if (out.size() < offset + len) {
+      out.resize(offset + len, '\0');
+    }
+    memcpy(out.data() + offset, p, len);
+    return 0;
+  };
+  if (WriteCfb(streams, opts, &size, write) != 0) {
+    return std::string();
+  }
+  out.resize(size, '\0');
+  return out;
+}
+
+// Only the written ranges take up disk space, the rest stays a hole.
+int WriteCfbFile(const std::string &path,
+                 const std::vector<cfb_stream_t> &streams,
+                 const cfb_opts_t &opts) {
+  int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return -1;
+  }
+  uint64_t size = 0;
+  auto write = [fd](uint64_t offset, const char *p, size_t len) {
+    return pwrite(fd, p, len, offset) == static_cast<ssize_t>(len) ? 0 : -1;
+  };
+  int ret = WriteCfb(streams, opts, &size, write);
+  if (ret == 0 && ftruncate(fd, size) != 0) {
+    ret = -1;
+  }
+  return close(fd) == 0 ? ret : -1;
+}
+
+// =============================================================================
+
+std::string MakeDoc(uint32_t seed, size_t paragraphs,
+                    const cfb_opts_t &opts) {
+  std::mt19937 rng(seed);
+
+  // The FIB fills the first 1 KB, the text follows it.
+  std::string word_doc(1024, '\0');
+  std::vector<int32_t> cps = {0};
+  std::string pcds;
+  auto add_piece = [&](const std::string &text, bool unicode) {
+    msoffice::doc::Pcd_t pcd;
+    memset(&pcd, 0, sizeof(pcd));
+    uint32_t fc = word_doc.size();
+    if (unicode) {
+      auto u16 = utf8_to_utf16(text);
+      put_u16(&word_doc, u16);
+      pcd.fc.flags = fc;
+      cps.push_back(cps.back() + u16.size());
+    } else {
+      word_doc.append(text);
+      pcd.fc.flags = (fc * 2) | (1u << 30);
+      cps.push_back(cps.back() + text.size());
+    }
+    pcds.append(reinterpret_cast<const char *>(&pcd), sizeof(pcd));
+  };
+
+  for (size_t i = 0; i < paragraphs; ++i) {
+    bool unicode = i % 2 == 1;
+    add_piece(random_words(&rng, 4 + rng() % 12, unicode) + "\r", unicode);
+  }
+  int32_t ccp_text = cps.back();
+  add_piece("footnote " + random_words(&rng, 3, false) + "\r", false);
+  int32_t ccp_ftn = cps.back() - ccp_text;
+  add_piece("\r", false);
+
+  auto fib_base = reinterpret_cast<msoffice::doc::fib_base_t *>(&word_doc[0]);
+  fib_base->wIdent = 0xA5EC;
+  fib_base->nFib = 0xC1;
+  fib_base->flags2 = 0x02;  // fWhichTblStm: 1Table
+
+  // FibRgLw97 and FibRgFcLcb97 sit at fixed offsets in a Word 97 FIB.
+  msoffice::doc::FibRgLw97_t lw;
+  memset(&lw, 0, sizeof(lw));
+  lw.cbMac = word_doc.size();
+  lw.ccpText = ccp_text;
+  lw.ccpFtn = ccp_ftn;
+  memcpy(&word_doc[0x40], &lw, sizeof(lw));
+
+  std::string table(16, '\0');
+  std::string clx;
+  clx.push_back(0x02);
+  put<uint32_t>(&clx, cps.size() * 4 + pcds.size());
+  for (int32_t cp : cps) {
+    put(&clx, cp);
+  }
+  clx.append(pcds);
+
+  msoffice::doc::FibRgFcLcb97_t fc_lcb;
+  memcpy(&fc_lcb, &word_doc[0x9A], sizeof(fc_lcb));
+  fc_lcb.fcClx = table.size();
+  fc_lcb.lcbClx = clx.size();
+  memcpy(&word_doc[0x9A], &fc_lcb, sizeof(fc_lcb));
+  table.append(clx);
+
+  return MakeCfb({{u"WordDocument", word_doc}, {u"1Table", table}}, opts);
+}
+
+// =============================================================================
+
+static void append_biff(std::string *out, uint16_t type,
+                        const std::string &data) {
+  put(out, type);
+  put<uint16_t>(out, data.size());
+  out->append(data);
+}
+
+static std::string biff_bof(uint16_t dt) {
+  std::string s;
+  put<uint16_t>(&s, 0x0600);
+  put<uint16_t>(&s, dt);
+  put<uint16_t>(&s, 0);
+  put<uint16_t>(&s, 0);
+  put<uint32_t>(&s, 0);
+  put<uint32_t>(&s, 0);
+  return s;
+}
+
+std::string MakeXls(uint32_t seed, int sheets, size_t rows,
+                    const cfb_opts_t &opts) {
+  std::mt19937 rng(seed);
+  const size_t sst_cnt = 64 + rows;
+  const size_t max_record_len = 8224;
+
+  // SST, continued in CONTINUE records at string boundaries.
+  std::vector<std::string> blocks(1);
+  put<uint32_t>(&blocks[0], sst_cnt);
+  put<uint32_t>(&blocks[0], sst_cnt);
+  for (size_t i = 0; i < sst_cnt; ++i) {
+    auto u16 = utf8_to_utf16(random_words(&rng, 1 + rng() % 4, true) + " " +
+                             std::to_string(i));
+    bool wide = std::any_of(u16.begin(), u16.end(),
+                            [](char16_t c) { return c > 0xff; });
+    std::string s;
+    put<uint16_t>(&s, u16.size());
+    s.push_back(wide ? 1 : 0);
+    if (wide) {
+      put_u16(&s, u16);
+    } else {
+      for (char16_t c : u16) {
+        s.push_back(static_cast<char>(c));
+      }
+    }
+    if (blocks.back().size() + s.size() > max_record_len) {
+      blocks.emplace_back();
+    }
+    blocks.back().append(s);
+  }
+
+  std::string globals;
+  append_biff(&globals, 0x0809, biff_bof(0x0005));
+  std::vector<size_t> pos_fields;
+  for (int i = 0; i < sheets; ++i) {
+    std::string name = "Sheet" + std::to_string(i + 1);
+    std::string bs;
+    put<uint32_t>(&bs, 0);
+    put<uint8_t>(&bs, 0);
+    put<uint8_t>(&bs, 0);
+    put<uint8_t>(&bs, name.size());
+    put<uint8_t>(&bs, 0);
+    bs.append(name);
+    pos_fields.push_back(globals.size() + 4);
+    append_biff(&globals, 0x0085, bs);
+  }
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    append_biff(&globals, i == 0 ? 0x00FC : 0x003C, blocks[i]);
+  }
+  append_biff(&globals, 0x000A, std::string());
+
+  std::string workbook = globals;
+  for (int i = 0; i < sheets; ++i) {
+    uint32_t pos = workbook.size();
+    memcpy(&workbook[pos_fields[i]], &pos, sizeof(pos));
+
+    append_biff(&workbook, 0x0809, biff_bof(0x0010));
+    for (size_t r = 0; r < rows; ++r) {
+      for (uint16_t c = 0; c < 4; ++c) {
+        std::string cell;
+        put<uint16_t>(&cell, r);
+        put(&cell, c);
+        put<uint16_t>(&cell, 0);
+        if (c == 0 || c == 3) {  // LabelSst
+          put<uint32_t>(&cell, rng() % sst_cnt);
+          append_biff(&workbook, 0x00FD, cell);
+        } else if (c == 1) {  // Number
+          put<double>(&cell, (rng() % 1000000) / 128.0 - 1000.0);
+          append_biff(&workbook, 0x0203, cell);
+        } else {  // RK, integer
+          put<uint32_t>(&cell, ((rng() % 100000) << 2) | 0x02);
+          append_biff(&workbook, 0x027E, cell);
+        }
+      }
+    }
+    append_biff(&workbook, 0x000A, std::string());
+  }
+
+  return MakeCfb({{u"Workbook", workbook}}, opts);
+}
+
+std::string MakeXlsCells(const std::vector<xls_cell_t> &cells,
+                         const cfb_opts_t &opts) {
+  std::string bs;
+  put<uint32_t>(&bs, 0);
+  put<uint8_t>(&bs, 0);
+  put<uint8_t>(&bs, 0);
+  put<uint8_t>(&bs, 6);
+  put<uint8_t>(&bs, 0);
+  bs.append("Sheet1");
+
+  std::string workbook;
+  append_biff(&workbook, 0x0809, biff_bof(0x0005));
+  size_t pos_field = workbook.size() + 4;
+  append_biff(&workbook, 0x0085, bs);
+  append_biff(&workbook, 0x000A, std::string());
+
+  uint32_t pos = workbook.size();
+  memcpy(&workbook[pos_field], &pos, sizeof(pos));
+  append_biff(&workbook, 0x0809, biff_bof(0x0010));
+  for (auto &c : cells) {
+    std::string cell;
+    put(&cell, c.row);
+    put(&cell, c.col);
+    put<uint16_t>(&cell, 0);
+    if (c.rk != 0) {
+      put(&cell, c.rk);
+      append_biff(&workbook, 0x027E, cell);
+    } else {
+      put(&cell, c.num);
+      append_biff(&workbook, 0x0203, cell);
+    }
+  }
+  append_biff(&workbook, 0x000A, std::string());
+
+  return MakeCfb({{u"Workbook", workbook}}, opts);
+}
+
+// =============================================================================
+
+static std::string ppt_record(uint16_t ver, uint16_t type,
+                              const std::string &body) {
+  std::string s;
+  put<uint16_t>(&s, ver);
+  put(&s, type);
+  put<uint32_t>(&s, body.size());
+  s.append(body);
+  return s;
+}
+
+static std::string ppt_text_atom(const std::string &text) {
+  auto u16 = utf8_to_utf16(text);
+  if (std::all_of(u16.begin(), u16.end(),
+                  [](char16_t c) { return c < 0x80; })) {
+    return ppt_record(0, msoffice::ppt::kRT_TextBytesAtom, text);
+  }
+  std::string body;
+  put_u16(&body, u16);
+  return ppt_record(0, msoffice::ppt::kRT_TextCharsAtom, body);
+}
+
+std::string MakePpt(uint32_t seed, int slides, const cfb_opts_t &opts) {
+  using namespace msoffice::ppt;
+  std::mt19937 rng(seed);
+
+  std::string titles;
+  for (int i = 0; i < slides; ++i) {
+    titles.append(ppt_text_atom(random_words(&rng, 3, true)));
+  }
+  std::string doc = ppt_record(
+      0xF, kRT_Document, ppt_record(0xF, kRT_SlideListWithText, titles));
+
+  // Persist id 1 is the document, the slides follow.
+  std::vector<uint32_t> offsets = {0};
+  for (int i = 0; i < slides; ++i) {
+    std::string text = ppt_text_atom(random_words(&rng, 8 + rng() % 16, true));
+    std::string sp = ppt_record(0xF, kRT_OfficeArtSpContainer,
+                                ppt_record(0xF, kRT_OfficeArtClientTextbox,
+                                           text));
+    std::string drawing = ppt_record(
+        0xF, kRT_Drawing,
+        ppt_record(0xF, kRT_OfficeArtDg,
+                   ppt_record(0xF, kRT_OfficeArtSpgrContainer, sp)));
+    offsets.push_back(doc.size());
+    doc.append(ppt_record(0xF, kRT_Slide, drawing));
+  }
+
+  std::string dir;
+  put<uint32_t>(&dir, 1 | (offsets.size() << 20));
+  for (uint32_t ofs : offsets) {
+    put(&dir, ofs);
+  }
+  uint32_t dir_offset = doc.size();
+  doc.append(ppt_record(0, kRT_PersistDirectoryAtom, dir));
+
+  UserEditAtom_t edit;
+  memset(&edit, 0, sizeof(edit));
+  edit.rh.recType = kRT_UserEditAtom;
+  edit.rh.recLen = sizeof(edit) - sizeof(record_header_t);
+  edit.lastSlideIdRef = 256;
+  edit.majorVersion = 3;
+  edit.offsetPersistDirectory = dir_offset;
+  edit.docPersistIdRef = 1;
+  edit.persistIdSeed = offsets.size() + 1;
+  edit.lastView = 1;
+  uint32_t edit_offset = doc.size();
+  doc.append(reinterpret_cast<const char *>(&edit), sizeof(edit));
+
+  const std::string user = "sample";
+  CurrentUserAtom::hdr_t hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.rh.recType = kRT_CurrentUserAtom;
+  hdr.rh.recLen = sizeof(hdr) - sizeof(record_header_t) + user.size() + 4 +
+                  user.size() * 2;
+  hdr.size = 0x14;
+  hdr.headerToken = 0xE391C05F;
+  hdr.offsetToCurrentEdit = edit_offset;
+  hdr.lenUserName = user.size();
+  hdr.docFileVersion = 0x03F4;
+  hdr.majorVersion = 3;
+  std::string current_user(reinterpret_cast<const char *>(&hdr), sizeof(hdr));
+  current_user.append(user);
+  put<uint32_t>(&current_user, 8);
+  put_u16(&current_user, utf8_to_utf16(user));
+
+  return MakeCfb(
+      {{u"Current User", current_user}, {u"PowerPoint Document", doc}}, opts);
+}
+
+// =============================================================================
+
+std::string MakePdf(uint32_t seed, int pages) {
+  std::mt19937 rng(seed);
+  std::vector<std::string> objs = {
+      "<< /Type /Catalog /Pages 2 0 R >>",
+      "",
+      "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>",
+  };
+  std::string kids;
+  for (int i = 0; i < pages; ++i) {
+    std::string content = "BT /F1 12 Tf 72 720 Td 14 TL";
+    for (int line = 0; line < 20; ++line) {
+      content += " (" + random_words(&rng, 6, false) + ") Tj T*";
+    }
+    content += " ET";
+
+    int page_id = objs.size() + 1;
+    kids += std::to_string(page_id) + " 0 R ";
+    objs.push_back(
+        "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 612 792] /Resources "
+        "<< /Font << /F1 3 0 R >> >> /Contents " +
+        std::to_string(page_id + 1) + " 0 R >>");
+    objs.push_back("<< /Length " + std::to_string(content.size()) +
+                   " >>\nstream\n" + content + "\nendstream");
+  }
+  objs[1] = "<< /Type /Pages /Kids [" + kids +
+            "] /Count " + std::to_string(pages) + " >>";
+
+  std::string pdf = "%PDF-1.4\n";
+  std::vector<size_t> offsets;
+  for (size_t i = 0; i < objs.size(); ++i) {
+    offsets.push_back(pdf.size());
+    pdf += std::to_string(i + 1) + " 0 obj\n" + objs[i] + "\nendobj\n";
+  }
+  size_t xref = pdf.size();
+  pdf += "xref\n0 " + std::to_string(objs.size() + 1) +
+         "\n0000000000 65535 f \n";
+  char entry[32];
+  for (size_t ofs : offsets) {
+    snprintf(entry, sizeof(entry), "%010zu 00000 n \n", ofs);
+    pdf += entry;
+  }
+  pdf += "trailer\n<< /Size " + std::to_string(objs.size() + 1) +
+         " /Root 1 0 R >>\nstartxref\n" + std::to_string(xref) + "\n%%EOF\n";
+  return pdf;
+}
+
+// =============================================================================
+
+typedef std::vector<std::pair<std::string, std::string>> zip_parts_t;
+
+static int write_zip(const std::string &path, const zip_parts_t &parts) {
+  int err = 0;
+  zip_t *za = zip_open(path.c_str(), ZIP_CREATE | ZIP_TRUNCATE, &err);
+  if (za == nullptr) {
+    return -1;
+  }
+  for (auto &part : parts) {
+    zip_source_t *src =
+        zip_source_buffer(za, part.second.data(), part.second.size(), 0);
+    if (src == nullptr ||
+        zip_file_add(za, part.first.c_str(), src, ZIP_FL_ENC_UTF_8) < 0) {
+      zip_source_free(src);
+      zip_discard(za);
+      return -1;
+    }
+  }
+  return zip_close(za) == 0 ? 0 : -1;
+}
+
+static const char kXmlDecl[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>\n";
+
+std::string MakeDocxDocument(uint32_t seed, size_t paragraphs) {
+  std::mt19937 rng(seed);
+  std::string doc = std::string(kXmlDecl) +
+                    "<w:document xmlns:w=\"http://schemas.openxmlformats.org/"
+                    "wordprocessingml/2006/main\"><w:body>";
+  for (size_t i = 0; i < paragraphs; ++i) {
+    doc += "<w:p><w:pPr><w:pStyle w:val=\"Normal\"/></w:pPr>";
+    for (int r = 1 + rng() % 4; r > 0; --r) {
+      doc += "<w:r><w:rPr><w:b/></w:rPr><w:t xml:space=\"preserve\">" +
+             xml_escape(random_words(&rng, 2 + rng() % 6, true)) +
+             " </w:t></w:r>";
+    }
+    doc += "</w:p>";
+  }
+  doc += "</w:body></w:document>";
+  return doc;
+}
+
+int WriteDocx(const std::string &path, uint32_t seed, size_t paragraphs) {
+  return write_zip(path, {{"[Content_Types].xml", "<Types/>"},
+                          {"word/document.xml",
+                           MakeDocxDocument(seed, paragraphs)}});
+}
+
+int WriteXlsx(const std::string &path, uint32_t seed, int sheets,
+              size_t rows) {
+  std::mt19937 rng(seed);
+  const size_t sst_cnt = 64 + rows;
+  zip_parts_t parts = {{"[Content_Types].xml", "<Types/>"}};
+
+  std::string sst = std::string(kXmlDecl) + "<sst count=\"" +
+                    std::to_string(sst_cnt) + "\">";
+  for (size_t i = 0; i < sst_cnt; ++i) {
+    sst += "<si><t xml:space=\"preserve\">" +
+           xml_escape(random_words(&rng, 1 + rng() % 4, true)) + " " +
+           std::to_string(i) + "</t></si>";
+  }
+  sst += "</sst>";
+  parts.push_back({"xl/sharedStrings.xml", sst});
+
+  std::string wb = std::string(kXmlDecl) + "<workbook><sheets>";
+  std::string rels = std::string(kXmlDecl) + "<Relationships>";
+  for (int i = 1; i <= sheets; ++i) {
+    std::string n = std::to_string(i);
+    wb += "<sheet name=\"Sheet" + n + "\" sheetId=\"" + n + "\" r:id=\"rId" +
+          n + "\"/>";
+    rels += "<Relationship Id=\"rId" + n +
+            "\" Target=\"worksheets/sheet" + n + ".xml\"/>";
+
+    std::string sheet = std::string(kXmlDecl) + "<worksheet><sheetData>";
+    for (size_t r = 1; r <= rows; ++r) {
+      std::string row = std::to_string(r);
+      sheet += "<row r=\"" + row + "\">";
+      sheet += "<c r=\"A" + row + "\" t=\"s\"><v>" +
+               std::to_string(rng() % sst_cnt) + "</v></c>";
+      sheet += "<c r=\"B" + row + "\"><v>" +
+               std::to_string((rng() % 1000000) / 128.0) + "</v></c>";
+      sheet += "<c r=\"C" + row + "\" s=\"1\"/>";
+      sheet += "<c r=\"D" + row + "\" t=\"s\"><v>" +
+               std::to_string(rng() % sst_cnt) + "</v></c>";
+      sheet += "</row>";
+    }
+    sheet += "</sheetData></worksheet>";
+    parts.push_back({"xl/worksheets/sheet" + n + ".xml", sheet});
+  }
+  wb += "</sheets></workbook>";
+  rels += "</Relationships>";
+  parts.push_back({"xl/workbook.xml", wb});
+  parts.push_back({"xl/_rels/workbook.xml.rels", rels});
+  return write_zip(path, parts);
+}
+
+int WritePptx(const std::string &path, uint32_t seed, int slides) {
+  std::mt19937 rng(seed);
+  zip_parts_t parts = {{"[Content_Types].xml", "<Types/>"}};
+
+  std::string pres = std::string(kXmlDecl) + "<p:presentation><p:sldIdLst>";
+  std::string rels = std::string(kXmlDecl) + "<Relationships>";
+  for (int i = 1; i <= slides; ++i) {
+    std::string n = std::to_string(i);
+    pres += "<p:sldId id=\"" + std::to_string(255 + i) + "\" r:id=\"rId" + n +
+            "\"/>";
+    rels += "<Relationship Id=\"rId" + n + "\" Target=\"slides/slide" + n +
+            ".xml\"/>";
+
+    std::string slide = std::string(kXmlDecl) +
+                        "<p:sld><p:cSld><p:spTree><p:sp><p:txBody>";
+    for (int p = 2 + rng() % 6; p > 0; --p) {
+      slide += "<a:p><a:r><a:rPr lang=\"en-US\"/><a:t>" +
+               xml_escape(random_words(&rng, 3 + rng() % 8, true)) +
+               "</a:t></a:r></a:p>";
+    }
+    slide += "</p:txBody></p:sp></p:spTree></p:cSld></p:sld>";
+    parts.push_back({"ppt/slides/slide" + n + ".xml", slide});
+  }
+  pres += "</p:sldIdLst></p:presentation>";
+  rels += "</Relationships>";
+  parts.push_back({"ppt/presentation.xml", pres});
+  parts.push_back({"ppt/_rels/presentation.xml.rels", rels});
+  return write_zip(path, parts);
+}
+
+}  // namespace samples
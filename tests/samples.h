@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Synthetic documents for the tests, benchmarks and the stress run. Every
+// generator is deterministic for a given seed.
+namespace samples {
+
+struct cfb_stream_t {
+  std::u16string name;
+  // The stream is `size` bytes long (data.size() if 0): `data` at the start,
+  // `tail` at the end and zeros in between, which file writers leave as
+  // holes.
+  std::string data;
+  uint64_t size = 0;
+  std::string tail;
+};
+
+struct cfb_opts_t {
+  int version = 3;  // 3: 512-byte sectors, 4: 4096-byte sectors
+  int sector_shift = 0;  // overrides the sector size of `version` if set
+  bool scatter = false;  // shuffle the sectors of all chains
+  uint32_t seed = 1;
+  // Free sectors appended to grow the SAT, e.g. past the 109 SAT sectors
+  // the header can list.
+  size_t pad_sectors = 0;
+};
+
+typedef std::function<int(uint64_t offset, const char *p, size_t len)>
+    write_fn_t;
+
+// Lays out a compound file with all streams in the root storage and hands
+// every non-zero byte range to `write`; *size is the file size.
+int WriteCfb(const std::vector<cfb_stream_t> &streams, const cfb_opts_t &opts,
+             uint64_t *size, const write_fn_t &write);
+std::string MakeCfb(const std::vector<cfb_stream_t> &streams,
+                    const cfb_opts_t &opts);
+int WriteCfbFile(const std::string &path,
+                 const std::vector<cfb_stream_t> &streams,
+                 const cfb_opts_t &opts);
+
+// Word 97 document: ANSI and UTF-16 pieces of main text followed by one
+// footnote subdocument.
+std::string MakeDoc(uint32_t seed, size_t paragraphs,
+                    const cfb_opts_t &opts = cfb_opts_t());
+
+// BIFF8 workbook with `sheets` sheets of `rows` (up to 65536) rows of four
+// cells mixing shared strings, numbers and RK values.
+std::string MakeXls(uint32_t seed, int sheets, size_t rows,
+                    const cfb_opts_t &opts = cfb_opts_t());
+
+// One cell of MakeXlsCells: a Number record, or an RK record if `rk` is set.
+struct xls_cell_t {
+  uint16_t row;
+  uint16_t col;
+  double num;
+  uint32_t rk;  // raw RkNumber
+};
+
+// BIFF8 workbook with one sheet holding exactly `cells`, in row order.
+std::string MakeXlsCells(const std::vector<xls_cell_t> &cells,
+                         const cfb_opts_t &opts = cfb_opts_t());
+
+// PowerPoint 97 presentation with outline text and one text box per slide.
+std::string MakePpt(uint32_t seed, int slides,
+                    const cfb_opts_t &opts = cfb_opts_t());
+
+std::string MakePdf(uint32_t seed, int pages);
+
+// word/document.xml of WriteDocx.
+std::string MakeDocxDocument(uint32_t seed, size_t paragraphs);
+int WriteDocx(const std::string &path, uint32_t seed, size_t paragraphs);
+int WriteXlsx(const std::string &path, uint32_t seed, int sheets,
+              size_t rows);
+int WritePptx(const std::string &path, uint32_t seed, int slides);
+
+int WriteFile(const std::string &path, const std::string &data);
+
+}  // namespace samples
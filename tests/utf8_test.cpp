@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "utils/utils.h"
+
+// Compares every SIMD UTF-8 kernel with the scalar one. Each byte sequence
+// under test is put at every offset of the first two 32-byte blocks and
+// followed by every tail length up to one block, so it crosses each block
+// and tail boundary; the start address moves along with the offset.
+//
+// Sequences: all 256 single bytes, which covers how each byte is classified,
+// and every 1- to 4-byte sequence over the bytes on either side of each
+// class boundary (ASCII, continuation, 2-, 3- and 4-byte leads).
+
+static const unsigned char kEdgeBytes[] = {
+    0x00, 0x7F, 0x80, 0xBF, 0xC0, 0xDF, 0xE0, 0xEF, 0xF0, 0xFF,
+};
+
+// Filler around the sequence: ASCII, 2-, 3- and 4-byte characters.
+static const char kFiller[] = "a\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80z";
+
+static const size_t kMaxOffset = 64;
+static const size_t kMaxTail = 33;
+
+static int g_failures = 0;
+
+struct checker_t {
+  std::vector<utils::utf8_kernel_t> kernels;
+  char storage[32 + kMaxOffset + 4 + kMaxTail];
+  std::vector<size_t> leads;
+
+  void check(const unsigned char *seq, size_t len) {
+    for (size_t offset = 0; offset < kMaxOffset; ++offset) {
+      char *s = storage + offset % 32;
+      size_t max_len = offset + len + kMaxTail;
+      for (size_t i = 0; i < max_len; ++i) {
+        s[i] = kFiller[i % (sizeof(kFiller) - 1)];
+      }
+      memcpy(s + offset, seq, len);
+
+      // Offsets of every character, from the scalar kernel.
+      const auto &ref = kernels[0];
+      leads.assign(1, ref.fix(s, max_len, 0));
+      while (leads.back() < max_len) {
+        size_t next = leads.back() + 1;
+        leads.push_back(next + ref.fix(s + next, max_len - next, 0));
+      }
+      size_t seq_cnt = ref.count(s, offset);
+      for (size_t tail = 0; tail < kMaxTail; ++tail) {
+        check_one(s, offset + len + tail, seq_cnt);
+      }
+    }
+  }
+
+  void check_one(const char *s, size_t slen, size_t seq_cnt) {
+    size_t cnt = std::lower_bound(leads.begin(), leads.end(), slen) -
+                 leads.begin();
+    for (size_t k = 1; k < kernels.size(); ++k) {
+      auto &kernel = kernels[k];
+      if (kernel.count(s, slen) != cnt) {
+        report(kernel.name, "count", s, slen, 0);
+      }
+      // The characters around the sequence, the first one and past the end.
+      size_t lo = seq_cnt > 0 ? seq_cnt - 1 : 0;
+      size_t hi = std::min(seq_cnt + 5, cnt + 1);
+      for (size_t n = lo; n <= hi; ++n) {
+        check_fix(kernel, s, slen, n, cnt);
+      }
+      check_fix(kernel, s, slen, 0, cnt);
+    }
+  }
+
+  void check_fix(const utils::utf8_kernel_t &kernel, const char *s,
+                 size_t slen, size_t n, size_t cnt) {
+    size_t expected = n < cnt ? leads[n] : slen;
+    if (kernel.fix(s, slen, n) != expected) {
+      report(kernel.name, "fix", s, slen, n);
+    }
+  }
+
+  void report(const char *kernel, const char *func, const char *s,
+              size_t slen, size_t n) {
+    if (++g_failures > 20) {
+      return;
+    }
+    fprintf(stderr, "%s %s(cnt %zu) differs from scalar on", kernel, func, n);
+    for (size_t i = 0; i < slen; ++i) {
+      fprintf(stderr, " %02x", static_cast<unsigned char>(s[i]));
+    }
+    fprintf(stderr, "\n");
+  }
+};
+
+int main() {
+  checker_t checker;
+  checker.kernels = utils::utf8_kernels_available();
+
+  unsigned char seq[4];
+  for (int a = 0; a < 256; ++a) {
+    seq[0] = a;
+    checker.check(seq, 1);
+  }
+  for (auto a : kEdgeBytes) {
+    seq[0] = a;
+    for (auto b : kEdgeBytes) {
+      seq[1] = b;
+      checker.check(seq, 2);
+      for (auto c : kEdgeBytes) {
+        seq[2] = c;
+        checker.check(seq, 3);
+        for (auto d : kEdgeBytes) {
+          seq[3] = d;
+          checker.check(seq, 4);
+        }
+      }
+    }
+  }
+
+  std::string names;
+  for (auto &kernel : checker.kernels) {
+    names += std::string(" ") + kernel.name;
+  }
+  if (g_failures > 0) {
+    fprintf(stderr, "utf8_test:%s: %d failures\n", names.c_str(), g_failures);
+    return 1;
+  }
+  printf("utf8_test:%s: ok\n", names.c_str());
+  return 0;
+}
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <string.h>
+
+#include <bit>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "msoffice/ms_xls/ms_xls.h"
+#include "tests/samples.h"
+
+// Numeric cells of an XLS sheet as each number format prints them.
+
+static int g_failures = 0;
+
+static const double kNaN = std::numeric_limits<double>::quiet_NaN();
+static const double kInf = std::numeric_limits<double>::infinity();
+
+static uint32_t rk_int(int32_t v, bool x100 = false) {
+  return (static_cast<uint32_t>(v) << 2) | 0x02 | (x100 ? 0x01 : 0);
+}
+
+// The upper 30 bits of the double, the rest must be zero.
+static uint32_t rk_double(double v, bool x100 = false) {
+  return (static_cast<uint32_t>(std::bit_cast<uint64_t>(v) >> 32) & ~3u) |
+         (x100 ? 0x01 : 0);
+}
+
+struct vector_t {
+  const char *what;
+  double num;
+  uint32_t rk;
+  const char *legacy;
+  const char *fixed3;
+  const char *shortest;
+};
+
+static const vector_t kVectors[] = {
+    // Numbers: "%f" up to 10, "%.2f" above.
+    {"small", 3.14159, 0, "3.141590", "3.142", "3.14159"},
+    {"ten", 10, 0, "10.000000", "10.000", "10"},
+    {"above ten", 12.345, 0, "12.35", "12.345", "12.345"},
+    {"tie", 10.125, 0, "10.12", "10.125", "10.125"},
+    {"negative", -5000.5, 0, "-5000.500000", "-5000.500", "-5000.5"},
+    {"tenth", 0.1, 0, "0.100000", "0.100", "0.1"},
+    {"tiny", 1e-7, 0, "0.000000", "0.000", "1e-07"},
+    {"negative zero", -0.0, 0, "-0.000000", "-0.000", "-0"},
+    {"large", 1e20, 0, "100000000000000000000.00",
+     "100000000000000000000.000", "1e+20"},
+    {"huge", 1e300, 0, nullptr, nullptr, "1e+300"},
+    {"nan", kNaN, 0, "nan", "nan", "nan"},
+    {"inf", kInf, 0, "inf", "inf", "inf"},
+    {"-inf", -kInf, 0, "-inf", "-inf", "-inf"},
+
+    // RK values: always "%.2f" in the legacy format.
+    {"rk int", 0, rk_int(42), "42.00", "42.000", "42"},
+    {"rk negative int", 0, rk_int(-7), "-7.00", "-7.000", "-7"},
+    {"rk int min", 0, rk_int(-(1 << 29)), "-536870912.00",
+     "-536870912.000", "-536870912"},
+    {"rk int x100", 0, rk_int(12345, true), "123.45", "123.450", "123.45"},
+    {"rk negative int x100", 0, rk_int(-1, true), "-0.01", "-0.010",
+     "-0.01"},
+    {"rk double", 0, rk_double(1.5), "1.50", "1.500", "1.5"},
+    {"rk double x100", 0, rk_double(1.5, true), "0.01", "0.015", "0.015"},
+    {"rk small double", 0, rk_double(0.125), "0.12", "0.125", "0.125"},
+};
+
+static std::vector<std::string> fetch_cells(const std::string &xls,
+                                            msoffice::xls_num_format_t format,
+                                            int precision) {
+  msoffice::fetch_text_options_t opts;
+  opts.xls_num_format = format;
+  opts.xls_num_precision = precision;
+  msoffice::xls::MsXLS doc;
+  std::string text;
+  if (doc.ParseFromSpan(xls) != 0 || doc.FetchText(&opts, &text) != 0) {
+    fprintf(stderr, "xls_num_test: cannot read the sample\n");
+    g_failures += 1;
+    return {};
+  }
+
+  // The sheet name, then one cell per line.
+  std::vector<std::string> lines;
+  for (size_t pos = 0; pos < text.size();) {
+    size_t end = text.find('\n', pos);
+    if (end == std::string::npos) {
+      end = text.size();
+    }
+    lines.push_back(text.substr(pos, end - pos));
+    pos = end + 1;
+  }
+  if (!lines.empty()) {
+    lines.erase(lines.begin());
+  }
+  return lines;
+}
+
+static void check(const char *format, const std::vector<std::string> &cells,
+                  const char *vector_t::*expected) {
+  size_t n = sizeof(kVectors) / sizeof(kVectors[0]);
+  if (cells.size() != n) {
+    fprintf(stderr, "%s: %zu cells, expected %zu\n", format, cells.size(), n);
+    g_failures += 1;
+    return;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    const char *want = kVectors[i].*expected;
+    if (want == nullptr) {
+      continue;
+    }
+    if (cells[i] != want) {
+      fprintf(stderr, "%s %s: got \"%s\", expected \"%s\"\n", format,
+              kVectors[i].what, cells[i].c_str(), want);
+      g_failures += 1;
+    }
+  }
+}
+
+int main() {
+  std::vector<samples::xls_cell_t> cells;
+  for (auto &v : kVectors) {
+    cells.push_back({static_cast<uint16_t>(cells.size()), 0, v.num, v.rk});
+  }
+  std::string xls = samples::MakeXlsCells(cells);
+
+  check("legacy", fetch_cells(xls, msoffice::kXlsNumLegacy, 0),
+        &vector_t::legacy);
+  check("fixed(3)", fetch_cells(xls, msoffice::kXlsNumFixed, 3),
+        &vector_t::fixed3);
+  check("shortest", fetch_cells(xls, msoffice::kXlsNumShortest, 0),
+        &vector_t::shortest);
+
+  // Precision is clamped to 0..20.
+  auto clamped = fetch_cells(xls, msoffice::kXlsNumFixed, 99);
+  auto max = fetch_cells(xls, msoffice::kXlsNumFixed, 20);
+  if (clamped != max || max.empty() || max[0] != "3.14158999999999988262") {
+    fprintf(stderr, "fixed(99) differs from fixed(20)\n");
+    g_failures += 1;
+  }
+  auto zero = fetch_cells(xls, msoffice::kXlsNumFixed, -1);
+  if (zero.size() < 3 || zero[0] != "3" || zero[2] != "12") {
+    fprintf(stderr, "fixed(-1) is not fixed(0)\n");
+    g_failures += 1;
+  }
+
+  if (g_failures > 0) {
+    fprintf(stderr, "xls_num_test: %d failures\n", g_failures);
+    return 1;
+  }
+  printf("xls_num_test: ok\n");
+  return 0;
+}
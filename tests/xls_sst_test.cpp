@@ -0,0 +1,58 @@
+#include <limits.h>
+#include <stdio.h>
+
+#include <string>
+
+#include "msoffice/ms_xls/ms_xls.h"
+#include "tests/samples.h"
+
+// How many XLS shared strings are read: xls_max_sst_cnt <= 0 is no limit,
+// which is what the command line passes, and a positive count cuts the
+// table so the strings past it print as "_".
+
+static int g_failures = 0;
+
+static std::string fetch(const std::string &xls, int max_sst_cnt, bool lazy) {
+  msoffice::fetch_text_options_t opts;
+  opts.xls_max_sst_cnt = max_sst_cnt;
+  opts.lazy_sst = lazy;
+  msoffice::xls::MsXLS doc;
+  std::string text;
+  if (doc.ParseFromSpan(xls) != 0 || doc.FetchText(&opts, &text) != 0) {
+    fprintf(stderr, "xls_sst_test: cannot read the sample\n");
+    g_failures += 1;
+  }
+  return text;
+}
+
+static void check(bool ok, const char *what, int max_sst_cnt, bool lazy) {
+  if (!ok) {
+    fprintf(stderr, "xls_max_sst_cnt %d%s: %s\n", max_sst_cnt,
+            lazy ? " lazy" : "", what);
+    g_failures += 1;
+  }
+}
+
+int main() {
+  // Shared strings in the first and last column of every row.
+  std::string xls = samples::MakeXls(1, 2, 300);
+  for (bool lazy : {false, true}) {
+    std::string all = fetch(xls, INT_MAX, lazy);
+    check(all.find('_') == std::string::npos, "placeholder with no limit",
+          INT_MAX, lazy);
+    for (int cnt : {0, -1}) {
+      check(fetch(xls, cnt, lazy) == all, "differs from no limit", cnt, lazy);
+    }
+
+    std::string one = fetch(xls, 1, lazy);
+    check(one.find("\n_,") != std::string::npos, "no placeholder", 1, lazy);
+    check(one.size() < all.size(), "not cut", 1, lazy);
+  }
+
+  if (g_failures > 0) {
+    fprintf(stderr, "xls_sst_test: %d failures\n", g_failures);
+    return 1;
+  }
+  printf("xls_sst_test: ok\n");
+  return 0;
+}
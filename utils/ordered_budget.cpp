@@ -0,0 +1,116 @@
+#include "utils/ordered_budget.h"
+
+#include "utils/utils.h"
+
+namespace utils {
+
+OrderedBudget::OrderedBudget(size_t max_len, std::string* out)
+    : m_out(out), m_remaining(max_len), m_next(0) {}
+
+size_t OrderedBudget::Remaining(size_t idx) const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return available(idx);
+}
+
+void OrderedBudget::Commit(size_t idx, const char* s, size_t slen) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (idx != m_next) {
+    buffer(idx, std::string(s, slen));
+    return;
+  }
+  append(s, slen);
+  m_next += 1;
+  flush();
+}
+
+void OrderedBudget::Commit(size_t idx, std::string&& text) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (idx != m_next) {
+    buffer(idx, std::move(text));
+    return;
+  }
+  append(text.c_str(), text.length());
+  m_next += 1;
+  flush();
+}
+
+void OrderedBudget::Skip(size_t idx) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (idx != m_next) {
+    m_pending[idx] = piece_t();
+    return;
+  }
+  m_next += 1;
+  flush();
+}
+
+// What is left for `idx` once the buffered pieces before it are appended.
+size_t OrderedBudget::available(size_t idx) const {
+  size_t left = m_remaining;
+  for (auto it = m_pending.begin(); it != m_pending.end() && it->first < idx;
+       ++it) {
+    left -= it->second.len;
+  }
+  return left;
+}
+
+void OrderedBudget::buffer(size_t idx, std::string&& text) {
+  size_t left = available(idx);
+  auto it = m_pending.find(idx);
+  if (it == m_pending.end()) {
+    it = m_pending.emplace(idx, piece_t()).first;
+  }
+  it->second.text = std::move(text);
+  it->second.len = count_utf8_word_cnt(it->second.text.c_str(),
+                                       it->second.text.length());
+  // The pieces after this one have that much less room.
+  for (; it != m_pending.end(); ++it) {
+    cut(&it->second, left);
+    left -= it->second.len;
+  }
+}
+
+// Cuts a buffered piece the way append() would with `max_len` left.
+void OrderedBudget::cut(piece_t* piece, size_t max_len) const {
+  if (piece->len <= max_len) {
+    return;
+  }
+  if (max_len == 0) {
+    piece->text.clear();
+  } else {
+    piece->text.resize(fix_utf8_word_cnt(piece->text.c_str(),
+                                         piece->text.length(), max_len));
+  }
+  piece->len = max_len;
+}
+
+void OrderedBudget::append(const char* s, size_t slen) {
+  if (m_remaining == 0) {
+    return;
+  }
+  size_t len = count_utf8_word_cnt(s, slen);
+  if (len <= m_remaining) {
+    m_out->append(s, slen);
+    m_remaining -= len;
+  } else {
+    m_out->append(s, fix_utf8_word_cnt(s, slen, m_remaining));
+    m_remaining = 0;
+  }
+}
+
+void OrderedBudget::flush() {
+  for (auto it = m_pending.begin();
+       it != m_pending.end() && it->first == m_next;
+       it = m_pending.erase(it), m_next += 1) {
+    append(it->second.text.c_str(), it->second.text.length());
+  }
+
+  // The pieces still waiting were cut before the ones just appended were in.
+  size_t left = m_remaining;
+  for (auto& piece : m_pending) {
+    cut(&piece.second, left);
+    left -= piece.second.len;
+  }
+}
+
+}  // namespace utils
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace utils {
+
+// Collects pieces of text produced out of order by several workers (pages,
+// sheets, slides) and appends them to `out` in index order, keeping the total
+// within `max_len` UTF-8 characters. The piece that crosses the limit is cut
+// at a character boundary; everything after it is dropped.
+//
+// Workers ask Remaining(idx) before starting on a piece and produce at most
+// that much. It subtracts the pieces before `idx` that are already buffered,
+// and buffered pieces are cut down as earlier ones arrive, so everything held
+// here stays within `max_len`. Earlier pieces still in flight cannot be
+// counted: each worker may still produce up to the whole remaining budget,
+// so the worst case is one budget per worker, not per piece.
+//
+// Every index in [0, n) must eventually be passed to either Commit() or
+// Skip(), otherwise later pieces stay buffered.
+class OrderedBudget {
+ public:
+  OrderedBudget(size_t max_len, std::string* out);
+
+  OrderedBudget(const OrderedBudget&) = delete;
+  OrderedBudget& operator=(const OrderedBudget&) = delete;
+
+  size_t Remaining(size_t idx) const;
+
+  void Commit(size_t idx, const char* s, size_t slen);
+  void Commit(size_t idx, std::string&& text);
+  void Skip(size_t idx);
+
+ private:
+  struct piece_t {
+    std::string text;
+    size_t len = 0;
+  };
+
+  size_t available(size_t idx) const;
+  void buffer(size_t idx, std::string&& text);
+  void cut(piece_t* piece, size_t max_len) const;
+  void append(const char* s, size_t slen);
+  void flush();
+
+ private:
+  mutable std::mutex m_mutex;
+  std::string* m_out;
+  size_t m_remaining;
+  size_t m_next;
+  std::map<size_t, piece_t> m_pending;
+};
+
+}  // namespace utils
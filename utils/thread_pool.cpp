@@ -0,0 +1,103 @@
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils {
+
+namespace {
+
+class WorkQueue {
+ public:
+  void Assign(size_t begin, size_t end) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = begin; i < end; ++i) {
+      m_idx.push_back(i);
+    }
+  }
+
+  bool PopFront(size_t* idx) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_idx.empty()) {
+      return false;
+    }
+    *idx = m_idx.front();
+    m_idx.pop_front();
+    return true;
+  }
+
+  bool StealBack(size_t* idx) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_idx.empty()) {
+      return false;
+    }
+    *idx = m_idx.back();
+    m_idx.pop_back();
+    return true;
+  }
+
+ private:
+  std::mutex m_mutex;
+  std::deque<size_t> m_idx;
+};
+
+}  // namespace
+
+void ParallelFor(size_t n, int workers,
+                 const std::function<void(int, size_t)>& fn) {
+  if (workers > static_cast<int>(n)) {
+    workers = static_cast<int>(n);
+  }
+  if (workers <= 1) {
+    for (size_t i = 0; i < n; ++i) {
+      fn(0, i);
+    }
+    return;
+  }
+
+  std::vector<std::unique_ptr<WorkQueue>> queues;
+  for (int w = 0; w < workers; ++w) {
+    queues.emplace_back(new WorkQueue);
+    queues.back()->Assign(n * w / workers, n * (w + 1) / workers);
+  }
+
+  // No work is added once the queues are filled, so a worker that fails to
+  // steal from every other queue can leave.
+  auto run = [&](int w) {
+    size_t idx;
+    for (;;) {
+      if (queues[w]->PopFront(&idx)) {
+        fn(w, idx);
+        continue;
+      }
+
+      bool stolen = false;
+      for (int i = 1; i < workers && !stolen; ++i) {
+        stolen = queues[(w + i) % workers]->StealBack(&idx);
+      }
+      if (!stolen) {
+        break;
+      }
+      fn(w, idx);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  for (int w = 1; w < workers; ++w) {
+    threads.emplace_back(run, w);
+  }
+  run(0);
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+int HardwareConcurrency() {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+}  // namespace utils
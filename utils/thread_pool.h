@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <functional>
+
+namespace utils {
+
+// Runs `fn(worker, idx)` for every idx in [0, n) on `workers` threads.
+//
+// Every worker starts with its own contiguous block of indices, pops from
+// the front of it and, once it runs dry, steals from the back of the other
+// workers' blocks. `worker` is in [0, workers), so callers can keep reusable
+// per-worker state in a vector indexed by it. With workers <= 1 everything
+// runs on the calling thread, in order.
+void ParallelFor(size_t n, int workers,
+                 const std::function<void(int, size_t)>& fn);
+
+int HardwareConcurrency();
+
+}  // namespace utils
@@ -6,11 +6,16 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <time.h>
 #include <unistd.h>
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
 #include <algorithm>
 #include <functional>
 #include <memory>
@@ -69,47 +74,187 @@ int read_file(const char* filename, std::string* data) {
 
 // =============================================================================
 
-static inline int count_utf8_word_width(const char* c) {
-  if (*c >= 0 && *c <= 127) {
-    return 1;
-  } else if ((*c & 0xE0) == 0xC0) {
-    return 2;
-  } else if ((*c & 0xF0) == 0xE0) {
-    return 3;
-  } else if ((*c & 0xF8) == 0xF0) {
-    return 4;
-  } else {
+MappedFile::MappedFile() : m_addr(nullptr), m_size(0) {}
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+int MappedFile::Open(const char* filename) {
+  Close();
+
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1) {
+    slog(Err, "open: %s, %s", filename, strerror(errno));
+    return -1;
+  }
+  _defer([&](...) { close(fd); });
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    slog(Err, "fstat: %s, %s", filename, strerror(errno));
+    return -1;
+  }
+  if (st.st_size == 0) {
+    return 0;
+  }
+
+  void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (addr == MAP_FAILED) {
+    slog(Err, "mmap: %s, %s", filename, strerror(errno));
     return -1;
   }
+  madvise(addr, st.st_size, MADV_SEQUENTIAL);
+  madvise(addr, st.st_size, MADV_WILLNEED);
+
+  m_addr = addr;
+  m_size = st.st_size;
+  return 0;
 }
 
-size_t count_utf8_word_cnt(const char* s, size_t slen) {
-  const char* p = s;
-  size_t len = 0;
-  for (size_t i = 0; i < slen;) {
-    int width = count_utf8_word_width(p + i);
-    if (width < 0) {
-      i += 1;
-      len += 1;
-    } else {
-      i += width;
-      len += 1;
+void MappedFile::Close() {
+  if (m_addr != nullptr) {
+    munmap(m_addr, m_size);
+    m_addr = nullptr;
+  }
+  m_size = 0;
+}
+
+// =============================================================================
+
+// A character is counted at every byte that is not a continuation byte
+// (10xxxxxx). For valid UTF-8 that is the number of code points; a stray
+// continuation byte is folded into the character before it.
+
+static inline bool is_utf8_cont(char c) {
+  return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+static size_t count_utf8_scalar(const char* s, size_t slen) {
+  size_t cnt = 0;
+  for (size_t i = 0; i < slen; ++i) {
+    cnt += !is_utf8_cont(s[i]);
+  }
+  return cnt;
+}
+
+// Offset of the first byte of character number `cnt`, or slen.
+static size_t fix_utf8_scalar(const char* s, size_t slen, size_t cnt) {
+  for (size_t i = 0; i < slen; ++i) {
+    if (!is_utf8_cont(s[i])) {
+      if (cnt == 0) {
+        return i;
+      }
+      cnt -= 1;
     }
   }
-  return len;
+  return slen;
+}
+
+#if defined(__x86_64__)
+
+// Continuation bytes are 0x80..0xBF, i.e. -128..-65 as signed chars.
+static inline uint32_t lead_mask_sse2(const char* p) {
+  __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  __m128i cont = _mm_cmplt_epi8(v, _mm_set1_epi8(-64));
+  return ~static_cast<uint32_t>(_mm_movemask_epi8(cont)) & 0xFFFF;
+}
+
+__attribute__((target("avx2"))) static inline uint32_t lead_mask_avx2(
+    const char* p) {
+  __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  __m256i cont = _mm256_cmpgt_epi8(_mm256_set1_epi8(-64), v);
+  return ~static_cast<uint32_t>(_mm256_movemask_epi8(cont));
+}
+
+// Index of the n-th (0-based) set bit of m; m has more than n bits set.
+static inline int nth_bit(uint32_t m, size_t n) {
+  for (; n > 0; --n) {
+    m &= m - 1;
+  }
+  return __builtin_ctz(m);
+}
+
+static size_t count_utf8_sse2(const char* s, size_t slen) {
+  size_t cnt = 0;
+  size_t i = 0;
+  for (; i + 16 <= slen; i += 16) {
+    cnt += __builtin_popcount(lead_mask_sse2(s + i));
+  }
+  return cnt + count_utf8_scalar(s + i, slen - i);
+}
+
+static size_t fix_utf8_sse2(const char* s, size_t slen, size_t cnt) {
+  size_t i = 0;
+  for (; i + 16 <= slen; i += 16) {
+    uint32_t m = lead_mask_sse2(s + i);
+    size_t n = __builtin_popcount(m);
+    if (n > cnt) {
+      return i + nth_bit(m, cnt);
+    }
+    cnt -= n;
+  }
+  return i + fix_utf8_scalar(s + i, slen - i, cnt);
+}
+
+__attribute__((target("avx2,popcnt"))) static size_t count_utf8_avx2(
+    const char* s, size_t slen) {
+  size_t cnt = 0;
+  size_t i = 0;
+  for (; i + 32 <= slen; i += 32) {
+    cnt += __builtin_popcount(lead_mask_avx2(s + i));
+  }
+  return cnt + count_utf8_scalar(s + i, slen - i);
+}
+
+__attribute__((target("avx2,popcnt"))) static size_t fix_utf8_avx2(
+    const char* s, size_t slen, size_t cnt) {
+  size_t i = 0;
+  for (; i + 32 <= slen; i += 32) {
+    uint32_t m = lead_mask_avx2(s + i);
+    size_t n = __builtin_popcount(m);
+    if (n > cnt) {
+      return i + nth_bit(m, cnt);
+    }
+    cnt -= n;
+  }
+  return i + fix_utf8_scalar(s + i, slen - i, cnt);
+}
+
+#endif
+
+std::vector<utf8_kernel_t> utf8_kernels_available() {
+  std::vector<utf8_kernel_t> kernels = {
+      {"scalar", count_utf8_scalar, fix_utf8_scalar}};
+#if defined(__x86_64__)
+  kernels.push_back({"sse2", count_utf8_sse2, fix_utf8_sse2});
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+    kernels.push_back({"avx2", count_utf8_avx2, fix_utf8_avx2});
+  }
+#endif
+  return kernels;
+}
+
+static const utf8_kernel_t& utf8_kernel() {
+  static const utf8_kernel_t kernel = utf8_kernels_available().back();
+  return kernel;
+}
+
+size_t count_utf8_word_cnt(const char* s, size_t slen) {
+  return utf8_kernel().count(s, slen);
 }
 
 size_t count_utf8_word_cnt(const std::string& str) {
   return count_utf8_word_cnt(str.c_str(), str.length());
 }
 
+size_t fix_utf8_word_cnt(const char* s, size_t slen, size_t cnt) {
+  return cnt == 0 ? 0 : utf8_kernel().fix(s, slen, cnt);
+}
+
 size_t fix_utf8_word_cnt(const char* s, size_t cnt) {
-  size_t offset = 0;
-  for (size_t i = 0; i < cnt; ++i) {
-    int w = count_utf8_word_width(s + offset);
-    offset += w == -1 ? 1 : w;
-  }
-  return offset;
+  return fix_utf8_word_cnt(s, strlen(s), cnt);
 }
 
 }  // namespace utils
@@ -12,9 +12,47 @@ namespace utils {
 int read_file(const char* filename, std::vector<char>* data);
 int read_file(const char* filename, std::string* data);
 
+// Read-only memory mapping of a whole file, unmapped on destruction.
+class MappedFile {
+ public:
+  MappedFile();
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  int Open(const char* filename);
+  void Close();
+
+  inline const char* Data() const {
+    return static_cast<const char*>(m_addr);
+  }
+  inline size_t Size() const {
+    return m_size;
+  }
+
+ private:
+  void* m_addr;
+  size_t m_size;
+};
+
+// Number of UTF-8 characters, counted as non-continuation bytes.
 size_t count_utf8_word_cnt(const std::string& str);
 size_t count_utf8_word_cnt(const char* s, size_t slen);
 
+// Byte length of the first `cnt` characters of s (all of it if it is
+// shorter). The two-argument form takes a NUL-terminated string.
+size_t fix_utf8_word_cnt(const char* s, size_t slen, size_t cnt);
 size_t fix_utf8_word_cnt(const char* s, size_t cnt);
 
+// The kernels behind the two functions above that this CPU can run, scalar
+// first and the one in use last. fix() returns the offset of character
+// number `cnt`, without the special case for cnt == 0.
+struct utf8_kernel_t {
+  const char* name;
+  size_t (*count)(const char* s, size_t slen);
+  size_t (*fix)(const char* s, size_t slen, size_t cnt);
+};
+std::vector<utf8_kernel_t> utf8_kernels_available();
+
 }  // namespace utils